@@ -10,22 +10,34 @@ interface KD {
   D: Vet4d;
 }
 
+// Options to control calibration.
+interface CalibrateExtra {
+  /**
+   * Find the board on a copy downscaled to this longest side first, then refine the
+   * corners at full resolution. Samples without a board are rejected at low resolution.
+   * Default 0 (full resolution detection).
+   */
+  coarseSize?: number;
+}
+
 /**
  * Performs camera calibaration
  * @param images - The batch checkboard images used to calibrate.
  * @param checkboardWidth - The number of cells in horizontal of checkboard.
  * @param checkboardHeight - The number of cells in vertial of checkboard.
+ * @param extra - Control how corners are detected.
  */
 export function calibrate(
   images: Buffer[],
   checkboardWidth: number,
-  checkboardHeight: number
+  checkboardHeight: number,
+  extra?: CalibrateExtra
 ): KD;
 
 // Options to control the generation of undistorted image.
 interface UndistortExtra {
   // Format of the dest image, use extname `.jpg`, `.png` to repersent
-  ext?: string;
+  extname?: string;
   /**
    * Quantity of the dest image
    * For JPEG, it can be a quality ( CV_IMWRITE_JPEG_QUALITY ) from 0 to 100 (the higher is the better). Default value is 95.
@@ -50,3 +62,123 @@ export function undistort(
   D: Vet4d,
   extra?: UndistortExtra
 ): Buffer;
+
+/**
+ * Same as `calibrate`, but decodes the images and solves on the libuv thread pool.
+ * The promise rejects if no checkboard is found.
+ */
+export function calibrateAsync(
+  images: Buffer[],
+  checkboardWidth: number,
+  checkboardHeight: number,
+  extra?: CalibrateExtra
+): Promise<KD>;
+
+/**
+ * Same as `undistort`, but decodes, undistorts and encodes on the libuv thread pool.
+ * The image buffer must not be modified until the promise settles.
+ */
+export function undistortAsync(
+  image: Buffer,
+  K: Matx33d,
+  D: Vet4d,
+  extra?: UndistortExtra
+): Promise<Buffer>;
+
+// Options for a batch undistortion.
+interface UndistortManyExtra extends UndistortExtra {
+  // Native threads working on the batch, default the number of CPU cores.
+  concurrency?: number;
+  /**
+   * Called on the main thread as each image finishes, in completion order.
+   * When set, the promise resolves with the number of images instead of the buffers.
+   */
+  onResult?: (error: Error | null, image: Buffer | null, index: number) => void;
+}
+
+/**
+ * Undistorts a batch of images on a native thread pool. Remap tables are built once
+ * per distinct image size and shared by all threads.
+ * @param images - The images to process. They must not be modified until the promise settles.
+ * @param K - Camera matrix.
+ * @param D - Distortion coefficients.
+ * @param extra - Concurrency, streaming callback and encoder settings.
+ * @returns The undistorted images in input order (rejects on the first failure), or the
+ * image count when `onResult` is given.
+ */
+export function undistortMany(
+  images: Buffer[],
+  K: Matx33d,
+  D: Vet4d,
+  extra?: UndistortManyExtra
+): Promise<Buffer[] | number>;
+
+// Layout of decoded 8-bit pixels, e.g. an RGBA frame from jimp.
+interface RawImage {
+  width: number;
+  height: number;
+  // 1 to 4, default 4.
+  channels?: number;
+  // Bytes between the starts of two rows, default width * channels.
+  stride?: number;
+}
+
+// Undistorted pixels, same channel count as the input.
+interface RawResult extends RawImage {
+  data: Buffer;
+  channels: number;
+  stride: number;
+}
+
+// Where raw output is written. It must not overlap the input pixels.
+interface RawOutputExtra {
+  // Caller-provided destination, otherwise a new Buffer is allocated.
+  output?: Buffer;
+  // Row pitch of `output`, default width * channels.
+  outputStride?: number;
+}
+
+/**
+ * Undistorts raw pixels without any encoding or decoding.
+ * @param pixels - The pixel data described by `image`.
+ * @param image - Size, channel count and row stride of `pixels`.
+ * @param K - Camera matrix.
+ * @param D - Distortion coefficients.
+ * @param extra - Output scale and optional destination buffer.
+ */
+export function undistortRaw(
+  pixels: Buffer,
+  image: RawImage,
+  K: Matx33d,
+  D: Vet4d,
+  extra?: RawOutputExtra & { scale?: number }
+): RawResult;
+
+// Encoder settings that can be changed per call on an Undistorter.
+interface EncodeExtra {
+  extname?: string;
+  quantity?: number;
+}
+
+/**
+ * Undistorts many images of one size with one calibration. The remap tables are
+ * computed once in the constructor and shared by all calls, including concurrent
+ * `undistortAsync` calls.
+ */
+export class Undistorter {
+  /**
+   * @param K - Camera matrix.
+   * @param D - Distortion coefficients.
+   * @param size - `[width, height]` of the input images.
+   * @param extra - Output scale and default encoder settings.
+   */
+  constructor(K: Matx33d, D: Vet4d, size: [number, number], extra?: UndistortExtra);
+
+  // Throws if the image size differs from the constructor size.
+  undistort(image: Buffer, extra?: EncodeExtra): Buffer;
+
+  undistortAsync(image: Buffer, extra?: EncodeExtra): Promise<Buffer>;
+
+  // Raw pixels in and out with the cached tables, see `undistortRaw`.
+  undistortRaw(pixels: Buffer, image: RawImage, extra?: RawOutputExtra): RawResult;
+}
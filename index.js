@@ -5,21 +5,23 @@ module.exports = fisheye;
 
 if (require.main === module) {
   const fs = require('fs');
+  const os = require('os');
   const path = require('path');
   const { promisify } = require('util');
 
   const args = process.argv.slice(2);
   if (args.length !== 5) {
-    console.log('Usage: fisheye <src_image> <dest_image> <samples_dir> <checkboard_width> <checkboard_height>');
+    console.log('Usage: fisheye <src_image|src_dir> <dest_image|dest_dir> <samples_dir> <checkboard_width> <checkboard_height>');
     process.exit(1);
   }
 
   const [src, dest, samplesDir, width, height] = args;
+  const isImage = f => f.match(/\.(jpg|jpeg|png|webp)$/i);
 
   (async () => {
     try {
       const files = fs.readdirSync(samplesDir)
-        .filter(f => f.match(/\.(jpg|jpeg|png|webp)$/i))
+        .filter(isImage)
         .map(f => path.join(samplesDir, f));
 
       if (files.length === 0) {
@@ -32,19 +34,61 @@ if (require.main === module) {
       console.log('Calibrating...');
       const { K, D } = fisheye.calibrate(imgs, parseInt(width), parseInt(height));
       
-      console.log(`Undistorting ${src}...`);
-      const originImg = await promisify(fs.readFile)(src);
-      const undistorted = fisheye.undistort(originImg, K, D, {
-        extname: path.extname(src),
-        scale: 1
+      // A directory is undistorted as one batch on the native thread pool
+      const batch = fs.statSync(src).isDirectory();
+      const sources = batch
+        ? fs.readdirSync(src).filter(isImage).map(f => path.join(src, f))
+        : [src];
+      const targets = batch
+        ? sources.map(f => path.join(dest, path.basename(f)))
+        : [dest];
+      if (batch) fs.mkdirSync(dest, { recursive: true });
+
+      // undistortMany takes one encoder setting per call, so each extension is its own batch
+      const groups = new Map();
+      sources.forEach((f, i) => {
+        const extname = path.extname(f).toLowerCase();
+        if (!groups.has(extname)) groups.set(extname, []);
+        groups.get(extname).push(i);
       });
-      
-      await promisify(fs.writeFile)(dest, undistorted);
-      console.log(`Saved to ${dest}`);
+
+      console.log(`Undistorting ${sources.length} image(s) from ${src}...`);
+      // Bounded chunks keep only a few images per core in memory, however large the folder
+      const chunkSize = 4 * os.cpus().length;
+      for (const [extname, indices] of groups) {
+        for (let start = 0; start < indices.length; start += chunkSize) {
+          const chunk = indices.slice(start, start + chunkSize);
+          const originImgs = await Promise.all(chunk.map(i => promisify(fs.readFile)(sources[i])));
+          const writes = [];
+          const done = new Set();
+          await fisheye.undistortMany(originImgs, K, D, {
+            extname,
+            scale: 1,
+            onResult: (err, undistorted, index) => {
+              done.add(index);
+              const source = sources[chunk[index]];
+              if (err) {
+                console.error(`Failed ${source}: ${err.message}`);
+                process.exitCode = 1;
+                return;
+              }
+              const target = targets[chunk[index]];
+              writes.push(promisify(fs.writeFile)(target, undistorted)
+                .then(() => console.log(`Saved to ${target}`)));
+            }
+          });
+          chunk.forEach((i, index) => {
+            if (!done.has(index)) {
+              console.error(`Failed ${sources[i]}: no result`);
+              process.exitCode = 1;
+            }
+          });
+          await Promise.all(writes);
+        }
+      }
     } catch (err) {
       console.error('Error:', err.message);
       process.exit(1);
     }
   })();
 }
-
@@ -1,4 +1,13 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <queue>
+#include <deque>
+#include <memory>
 #include <filesystem>
 #include <regex>
 #include <sstream>
@@ -13,10 +22,61 @@
 #include <opencv2/video.hpp> // For findTransformECC
 #include <tiffio.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#endif
+
 using namespace std;
 using namespace std::filesystem;
 using namespace cv;
 
+enum class CalibMode { Run, Plan, Apply, Preview, BenchDewarp, Daemon };
+
+struct CalibOptions {
+	CalibMode mode = CalibMode::Run;
+	string inDir = "input";
+	string outDir = "output";
+
+	// Two-phase mode
+	string planFile;                // Transform file written by --plan, read by --apply
+	double planScale = 1.0;         // Resolution the plan phase aligns at
+
+	// Output resolution
+	double outScale = 1.0;          // Fraction of the input resolution, (0-1]
+	Size outSize;                   // If set, fit the output inside this box instead
+
+	// QC preview
+	int previewFactor = 4;          // Decode at 1/2, 1/4 or 1/8 resolution
+
+	// Dewarp
+	bool dewarpOnTheFly = false;    // Evaluate the Brown model per pixel instead of cv::undistort maps
+	int benchRepeats = 5;
+
+	// Daemon
+	string socketPath;              // Serve jobs on this Unix socket instead of stdin
+	int workers = 2;                // Jobs processed concurrently
+	bool warmStart = false;         // Seed ECC with the previous correction of the same band
+
+	// Alignment
+	bool phaseCorr = false;         // FFT phase-correlation pre-alignment before ECC
+	int phaseCorrSize = 512;        // Longest side of the downsampled pair
+	double phaseCorrMinResponse = 0.05;
+
+	int eccIterations = 50;         // Full ECC budget
+
+	// Adaptive budget: score H_meta on a low-res pair, then skip, shorten or run full ECC
+	bool adaptive = false;
+	int adaptiveSize = 512;         // Longest side of the scoring pair
+	double adaptiveSkipCC = 0.97;   // cc >= this: keep H_meta as is
+	double adaptiveShortCC = 0.85;  // cc >= this: short refinement
+	int adaptiveShortIterations = 10;
+};
+
 struct ImageInfo {
 	string path;
 	string filename;
@@ -36,6 +96,93 @@ struct ImageInfo {
 	bool foundH = false;
 };
 
+// Result of the alignment steps for one image. H_total maps reference pixels to
+// dewarped image pixels and is applied with WARP_INVERSE_MAP.
+struct ImagePlan {
+	ImageInfo info;
+	Mat H_total = Mat::eye(3, 3, CV_64F);
+	double cc = -1;
+	string seed;                    // ECC start: "warmStart", "phaseCorr", "identity" (empty = no ECC)
+};
+
+// Dewarped reference image of a group, prepared for ECC
+struct AlignReference {
+	const ImageInfo* info = nullptr;
+	Mat image;
+	Mat gray;                       // Full size ECC gray
+	Mat small;                      // Downscaled ECC gray for adaptive scoring
+	double smallScale = 1.0;
+};
+
+// Thread-safe cache bounded to `capacity` entries and, when `maxBytes` is set, to that many
+// bytes as measured by `bytes` (oldest evicted first). Holds state that stays warm across
+// images of a batch and, in daemon mode, across jobs.
+template <typename T>
+class WarmCache {
+public:
+	explicit WarmCache(size_t capacity, size_t maxBytes = 0, function<size_t(const T&)> bytes = nullptr)
+		: capacity(capacity), maxBytes(maxBytes), bytes(bytes) {}
+
+	bool get(const string& key, T& value) {
+		lock_guard<mutex> lock(mtx);
+		auto it = entries.find(key);
+		if (it == entries.end()) return false;
+		value = it->second;
+		return true;
+	}
+
+	void put(const string& key, const T& value) {
+		lock_guard<mutex> lock(mtx);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			total -= cost(it->second);
+			order.erase(find(order.begin(), order.end(), key));
+		}
+		order.push_back(key);
+		entries[key] = value;
+		total += cost(value);
+
+		// The entry just stored is never evicted, even if it alone exceeds maxBytes
+		while (order.size() > 1 && (order.size() > capacity || (maxBytes > 0 && total > maxBytes))) {
+			total -= cost(entries[order.front()]);
+			entries.erase(order.front());
+			order.pop_front();
+		}
+	}
+
+private:
+	size_t cost(const T& value) const { return bytes ? bytes(value) : 0; }
+
+	mutex mtx;
+	size_t capacity;
+	size_t maxBytes;
+	function<size_t(const T&)> bytes;
+	size_t total = 0;
+	map<string, T> entries;
+	deque<string> order;
+};
+
+// Dewarp remap tables by camera parameters and image size. Only used in daemon mode:
+// whole-frame tables cost ~6 bytes per pixel, so one-shot runs keep cv::undistort's
+// striped map building. Bounded to 512 MB (about four 20 MP bands).
+bool g_warmDewarpMaps = false;
+WarmCache<pair<Mat, Mat>> g_dewarpMaps(16, size_t(512) << 20, [](const pair<Mat, Mat>& maps) {
+	return maps.first.total() * maps.first.elemSize() + maps.second.total() * maps.second.elemSize();
+});
+// Last ECC correction (H_ecc) per band, used to warm start the next capture
+WarmCache<Mat> g_bandCorrection(64);
+
+struct CalibStats {
+	int images = 0;
+	int failed = 0;
+	map<string, int> seeds;         // ECC runs by start point
+};
+
+// Neither applies EXIF orientation (READ_FULL is IMREAD_UNCHANGED), so plan, apply and
+// metadata sizes all refer to the same pixel frame
+const int READ_FULL = IMREAD_UNCHANGED | IMREAD_ANYDEPTH | IMREAD_ANYCOLOR;
+const int READ_GRAY = IMREAD_GRAYSCALE | IMREAD_ANYDEPTH | IMREAD_IGNORE_ORIENTATION;
+
 // Helper to parse the XML metadata string
 void parseXmlMetadata(const string& xml, ImageInfo& info) {
 	smatch m;
@@ -102,10 +249,21 @@ void parseXmlMetadata(const string& xml, ImageInfo& info) {
 	}
 }
 
-string getXmpFromJpeg(const string& filename) {
+bool isTiffExt(const string& ext) {
+	return ext == "tif" || ext == "TIF" || ext == "tiff" || ext == "TIFF";
+}
+
+bool isJpegExt(const string& ext) {
+	return ext == "jpg" || ext == "JPG" || ext == "jpeg" || ext == "JPEG";
+}
+
+// XMP packet of a JPEG. When `frameSize` is given it also receives the image size from
+// the SOF segment, so callers need not decode the image just to learn its dimensions.
+string getXmpFromJpeg(const string& filename, Size* frameSize = nullptr) {
     FILE* f = fopen(filename.c_str(), "rb");
     if (!f) return "";
 
+    string xmp;
     uint8_t buf[256];
     // Read SOI
     if (fread(buf, 1, 2, f) != 2 || buf[0] != 0xFF || buf[1] != 0xD8) {
@@ -132,11 +290,13 @@ string getXmpFromJpeg(const string& filename) {
                  if (fread(header, 1, 29, f) != 29) break;
                  if (memcmp(header, "http://ns.adobe.com/xap/1.0/", 29) == 0) {
                      // Found XMP
-                     string xmp;
                      xmp.resize(contentLen - 29);
-                     if (fread(&xmp[0], 1, contentLen - 29, f) != contentLen - 29) break;
-                     fclose(f);
-                     return xmp;
+                     if (fread(&xmp[0], 1, contentLen - 29, f) != contentLen - 29) {
+                         xmp.clear();
+                         break;
+                     }
+                     // The frame header follows the APP segments
+                     if (!frameSize) break;
                  } else {
                      // Not XMP, skip rest of segment
                      fseek(f, contentLen - 29, SEEK_CUR);
@@ -144,6 +304,13 @@ string getXmpFromJpeg(const string& filename) {
              } else {
                  fseek(f, contentLen, SEEK_CUR);
              }
+        } else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            // SOFn: precision (1), height (2), width (2). Nothing after it is of interest
+            uint8_t sof[5];
+            if (frameSize && contentLen >= 5 && fread(sof, 1, 5, f) == 5) {
+                *frameSize = Size((sof[3] << 8) | sof[4], (sof[1] << 8) | sof[2]);
+            }
+            break;
         } else if (marker == 0xD9 || marker == 0xDA) {
             // EOI or SOS - stop scanning
             break;
@@ -153,7 +320,7 @@ string getXmpFromJpeg(const string& filename) {
         }
     }
     fclose(f);
-    return "";
+    return xmp;
 }
 
 ImageInfo parseMetadata(const string& filePath) {
@@ -163,7 +330,7 @@ ImageInfo parseMetadata(const string& filePath) {
 	info.ext = info.filename.substr(info.filename.find_last_of(".") + 1);
 
 	// Check for TIFF extension before trying TIFFOpen to avoid warnings/errors on JPEGs
-	bool isTiff = (info.ext == "tif" || info.ext == "TIF" || info.ext == "tiff" || info.ext == "TIFF");
+	bool isTiff = isTiffExt(info.ext);
 
 	if (isTiff) {
 		TIFF* tif = TIFFOpen(filePath.c_str(), "r");
@@ -184,12 +351,20 @@ ImageInfo parseMetadata(const string& filePath) {
 
 	// Fallback for non-TIFF files (like JPG) or if TIFF parsing failed
 	// 1. Try to read XMP from JPEG structure
-	string xmp = getXmpFromJpeg(filePath);
+	Size frameSize;
+	string xmp = getXmpFromJpeg(filePath, &frameSize);
 	if (!xmp.empty()) {
 		parseXmlMetadata(xmp, info);
 	}
 
-	// 2. Read dimensions via OpenCV (robust fallback)
+	// 2. Dimensions from the JPEG frame header, without decoding
+	if (frameSize.area() > 0) {
+		info.width = frameSize.width;
+		info.height = frameSize.height;
+		return info;
+	}
+
+	// 3. Read dimensions via OpenCV (robust fallback)
 	Mat img = imread(filePath, IMREAD_UNCHANGED);
 	if (!img.empty()) {
 		info.width = img.cols;
@@ -199,45 +374,813 @@ ImageInfo parseMetadata(const string& filePath) {
 	return info;
 }
 
-Mat undistortImg(const Mat& img, const ImageInfo& info) {
-	if (info.foundDistortion) {
-		double centerX = info.width > 0 ? info.width / 2.0 : info.calibratedCx;
-		double centerY = info.height > 0 ? info.height / 2.0 : info.calibratedCy;
+// Map-free Brown model dewarp (k1, k2, k3, p1, p2), equivalent to undistort(src, dst, K, D, K).
+// The model is evaluated on the fly for a few rows at a time and interpolated straight
+// away, so only a cache-resident tile of coordinates exists instead of a full-frame
+// float map. The per-pixel model is branch free float math the compiler vectorizes;
+// interpolation uses remap's SIMD paths (8U/16U, 1 to 4 channels). Tiles run in parallel.
+void dewarpBrown(const Mat& src, Mat& dst, const Mat& K, const Mat& D) {
+	dst.create(src.size(), src.type());
+
+	const float fx = float(K.at<double>(0, 0)), fy = float(K.at<double>(1, 1));
+	const float cx = float(K.at<double>(0, 2)), cy = float(K.at<double>(1, 2));
+	const float ifx = 1.f / fx, ify = 1.f / fy;
+	const float k1 = float(D.at<double>(0)), k2 = float(D.at<double>(1));
+	const float p1 = float(D.at<double>(2)), p2 = float(D.at<double>(3));
+	const float k3 = float(D.at<double>(4));
+
+	const int width = src.cols;
+	const int tileRows = max(1, min(src.rows, (1 << 14) / max(width, 1)));
+	const int numTiles = (src.rows + tileRows - 1) / tileRows;
+
+	parallel_for_(Range(0, numTiles), [&](const Range& range) {
+		Mat mapX(tileRows, width, CV_32F), mapY(tileRows, width, CV_32F);
+
+		for (int t = range.start; t < range.end; t++) {
+			int y0 = t * tileRows;
+			int rows = min(tileRows, src.rows - y0);
+
+			for (int r = 0; r < rows; r++) {
+				float* mx = mapX.ptr<float>(r);
+				float* my = mapY.ptr<float>(r);
+				const float y = (float(y0 + r) - cy) * ify;
+				const float y2 = y * y;
+
+				for (int u = 0; u < width; u++) {
+					float x = (float(u) - cx) * ifx;
+					float x2 = x * x;
+					float r2 = x2 + y2;
+					float radial = 1.f + r2 * (k1 + r2 * (k2 + r2 * k3));
+					float xd = x * radial + 2.f * p1 * x * y + p2 * (r2 + 2.f * x2);
+					float yd = y * radial + p1 * (r2 + 2.f * y2) + 2.f * p2 * x * y;
+					mx[u] = fx * xd + cx;
+					my[u] = fy * yd + cy;
+				}
+			}
+
+			Mat dstTile = dst.rowRange(y0, y0 + rows);
+			remap(src, dstTile, mapX.rowRange(0, rows), mapY.rowRange(0, rows), INTER_LINEAR, BORDER_CONSTANT);
+		}
+	});
+}
+
+// Camera matrix and Brown coefficients of an image's DewarpData
+void dewarpParams(const ImageInfo& info, Mat& K, Mat& D) {
+	double centerX = info.width > 0 ? info.width / 2.0 : info.calibratedCx;
+	double centerY = info.height > 0 ? info.height / 2.0 : info.calibratedCy;
 
-		// Matches drnmppr-dewarp.cpp logic:
-		// cx = Width/2 - dewarp_cx
-		// cy = Height/2 + dewarp_cy
-		double finalCx = centerX - info.cx_d;
-		double finalCy = centerY + info.cy_d;
+	// Matches drnmppr-dewarp.cpp logic:
+	// cx = Width/2 - dewarp_cx
+	// cy = Height/2 + dewarp_cy
+	double finalCx = centerX - info.cx_d;
+	double finalCy = centerY + info.cy_d;
+
+	K = (Mat_<double>(3, 3) << info.fx, 0, finalCx, 0, info.fy, finalCy, 0, 0, 1);
+	D = (Mat_<double>(1, 5) << info.k1, info.k2, info.p1, info.p2, info.k3);
+}
 
-		Mat K = (Mat_<double>(3, 3) << info.fx, 0, finalCx, 0, info.fy, finalCy, 0, 0, 1);
-		Mat D = (Mat_<double>(1, 5) << info.k1, info.k2, info.p1, info.p2, info.k3);
+Mat undistortImg(const Mat& img, const ImageInfo& info, bool onTheFly = false) {
+	if (info.foundDistortion) {
+		Mat K, D;
+		dewarpParams(info, K, D);
+		double finalCx = K.at<double>(0, 2), finalCy = K.at<double>(1, 2);
 
 		Mat dewarped;
-		undistort(img, dewarped, K, D, K);
+		if (onTheFly) {
+			dewarpBrown(img, dewarped, K, D);
+			return dewarped;
+		}
+
+		if (!g_warmDewarpMaps) {
+			undistort(img, dewarped, K, D, K);
+			return dewarped;
+		}
+
+		// Same tables as undistort(img, dewarped, K, D, K), built once per band and size
+		string key = cv::format("%dx%d|%.9g,%.9g,%.9g,%.9g|%.9g,%.9g,%.9g,%.9g,%.9g", img.cols, img.rows,
+			info.fx, info.fy, finalCx, finalCy, info.k1, info.k2, info.p1, info.p2, info.k3);
+		pair<Mat, Mat> maps;
+		if (!g_dewarpMaps.get(key, maps)) {
+			initUndistortRectifyMap(K, D, Mat(), K, img.size(), CV_16SC2, maps.first, maps.second);
+			g_dewarpMaps.put(key, maps);
+		}
+		remap(img, dewarped, maps.first, maps.second, INTER_LINEAR, BORDER_CONSTANT);
 		return dewarped;
 	}
 	return img.clone();
 }
 
 
+// Estimate the translation between two single channel CV_32F images with FFT phase
+// correlation on a downsampled pair. The returned shift is in full resolution pixels
+// and satisfies ref(x) ~ mov(x + shift), i.e. it is the translation part of an ECC warp.
+Point2d phaseCorrShift(const Mat& refGray, const Mat& movGray, int workSize, double* response) {
+	// Both images share the pixel origin, so differently sized pairs are compared on their
+	// common top-left ROI rather than stretched onto each other
+	Rect common(0, 0, min(refGray.cols, movGray.cols), min(refGray.rows, movGray.rows));
+	Mat refCommon = refGray(common), movCommon = movGray(common);
+
+	double scale = min(1.0, double(workSize) / max(common.width, common.height));
+
+	Mat refSmall, movSmall;
+	if (scale < 1.0) {
+		resize(refCommon, refSmall, Size(), scale, scale, INTER_AREA);
+		resize(movCommon, movSmall, refSmall.size(), 0, 0, INTER_AREA);
+	} else {
+		refSmall = refCommon;
+		movSmall = movCommon;
+	}
+
+	Mat window;
+	createHanningWindow(window, refSmall.size(), CV_32F);
+	Point2d shift = phaseCorrelate(refSmall, movSmall, window, response);
+
+	return Point2d(shift.x / scale, shift.y / scale);
+}
+
+// Express a homography in the pixel grid of images resized by `scale`
+Mat scaleHomography(const Mat& H, double scale) {
+	Mat S = (Mat_<double>(3, 3) << scale, 0, 0, 0, scale, 0, 0, 0, 1);
+	return S * H * S.inv();
+}
+
+// Metadata of an image resampled by `scale`: every pixel-unit quantity (size, dewarp
+// intrinsics, optical center offsets, H) is scaled accordingly
+ImageInfo scaleInfo(const ImageInfo& info, double scale) {
+	ImageInfo out = info;
+	out.width = uint32_t(lround(info.width * scale));
+	out.height = uint32_t(lround(info.height * scale));
+	out.fx *= scale; out.fy *= scale;
+	out.cx_d *= scale; out.cy_d *= scale;
+	out.calibratedCx *= scale; out.calibratedCy *= scale;
+	out.relX *= scale; out.relY *= scale;
+	out.H = scaleHomography(info.H, scale);
+	return out;
+}
+
+// Decode a strip TIFF at roughly 1/factor resolution without decoding the full image:
+// a stored overview (reduced resolution IFD) is used when one is large enough,
+// otherwise only every factor-th scanline and column of the main image is read.
+// Returns an empty Mat for layouts it does not handle (tiles, planar, float).
+Mat readTiffReduced(const string& file, int factor) {
+	TIFF* tif = TIFFOpen(file.c_str(), "r");
+	if (!tif) return Mat();
+
+	uint32_t width = 0, height = 0;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+	uint32_t targetW = (width + factor - 1) / factor;
+
+	// Smallest overview that is still at least as wide as the target
+	tdir_t dir = 0;
+	uint32_t dirWidth = width;
+	tdir_t numDirs = TIFFNumberOfDirectories(tif);
+	for (tdir_t d = 1; d < numDirs; d++) {
+		if (!TIFFSetDirectory(tif, d)) break;
+
+		uint32_t subType = 0, w = 0;
+		TIFFGetFieldDefaulted(tif, TIFFTAG_SUBFILETYPE, &subType);
+		TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+		if ((subType & FILETYPE_REDUCEDIMAGE) && w >= targetW && w < dirWidth) {
+			dir = d;
+			dirWidth = w;
+		}
+	}
+	TIFFSetDirectory(tif, dir);
+
+	uint32_t w = 0, h = 0;
+	uint16_t bps = 8, spp = 1, planar = PLANARCONFIG_CONTIG, format = SAMPLEFORMAT_UINT, photometric = PHOTOMETRIC_MINISBLACK;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &h);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &format);
+	TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+
+	// Only plain gray (1 sample) and RGB(A) (3/4 samples) are copied directly. Gray+alpha,
+	// palette, YCbCr, MINISWHITE etc. are left to imread
+	bool plainGray = photometric == PHOTOMETRIC_MINISBLACK && spp == 1;
+	bool plainRgb = photometric == PHOTOMETRIC_RGB && (spp == 3 || spp == 4);
+	if (TIFFIsTiled(tif) || planar != PLANARCONFIG_CONTIG || format != SAMPLEFORMAT_UINT || (bps != 8 && bps != 16) || !(plainGray || plainRgb)) {
+		TIFFClose(tif);
+		return Mat();
+	}
+
+	int step = max(1, int(lround(double(w) / targetW)));
+	Mat out((h + step - 1) / step, (w + step - 1) / step, CV_MAKETYPE(bps == 16 ? CV_16U : CV_8U, spp));
+	vector<uchar> line(TIFFScanlineSize(tif));
+	size_t pixelBytes = out.elemSize();
+
+	for (int r = 0; r < out.rows; r++) {
+		if (TIFFReadScanline(tif, line.data(), uint32_t(r * step)) < 0) {
+			TIFFClose(tif);
+			return Mat();
+		}
+		uchar* dst = out.ptr(r);
+		for (int c = 0; c < out.cols; c++) {
+			memcpy(dst + c * pixelBytes, line.data() + size_t(c) * step * pixelBytes, pixelBytes);
+		}
+	}
+	TIFFClose(tif);
+
+	if (spp == 3) cvtColor(out, out, COLOR_RGB2BGR);
+	else if (spp == 4) cvtColor(out, out, COLOR_RGBA2BGRA);
+	return out;
+}
+
+// Decode at 1/factor resolution (factor 2, 4 or 8): JPEG uses libjpeg DCT scaling,
+// TIFF uses readTiffReduced. Anything else falls back to a full decode.
+Mat readReduced(const ImageInfo& info, int flags, int factor) {
+	bool gray = flags == READ_GRAY || flags == IMREAD_GRAYSCALE;
+
+	if (isJpegExt(info.ext)) {
+		int reduced = factor == 8 ? (gray ? IMREAD_REDUCED_GRAYSCALE_8 : IMREAD_REDUCED_COLOR_8)
+			: factor == 4 ? (gray ? IMREAD_REDUCED_GRAYSCALE_4 : IMREAD_REDUCED_COLOR_4)
+			: (gray ? IMREAD_REDUCED_GRAYSCALE_2 : IMREAD_REDUCED_COLOR_2);
+		// Full decodes ignore EXIF orientation, so the reduced one must too
+		return imread(info.path, reduced | IMREAD_IGNORE_ORIENTATION);
+	}
+
+	if (isTiffExt(info.ext)) {
+		Mat img = readTiffReduced(info.path, factor);
+		if (!img.empty()) {
+			if (gray && img.channels() > 1) cvtColor(img, img, img.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+			return img;
+		}
+	}
+
+	return imread(info.path, flags);
+}
+
+// Read an image resampled by `scale`. Downscaled reads decode at the largest of
+// 1/2, 1/4, 1/8 that is still at least the target size and area-filter the rest.
+Mat readImage(const ImageInfo& info, int flags, double scale = 1.0) {
+	if (scale >= 1.0) return imread(info.path, flags);
+
+	int factor = 1;
+	while (factor < 8 && factor * 2 <= 1.0 / scale + 1e-6) factor *= 2;
+
+	Mat img = factor > 1 ? readReduced(info, flags, factor) : imread(info.path, flags);
+	if (img.empty()) return img;
+
+	// Target size relative to the full resolution image
+	double fullW = info.width > 0 ? info.width : img.cols * factor;
+	double fullH = info.height > 0 ? info.height : img.rows * factor;
+	Size target(int(lround(fullW * scale)), int(lround(fullH * scale)));
+	if (img.size() == target) return img;
+
+	Mat small;
+	resize(img, small, target, 0, 0, INTER_AREA);
+	return small;
+}
+
+// Convert an image to a 0-1 normalized single channel CV_32F image as used by ECC,
+// optionally downscaled
+Mat toEccGray(const Mat& img, double scale = 1.0) {
+	Mat gray, gray32;
+	if (img.channels() > 1) cvtColor(img, gray, COLOR_BGR2GRAY);
+	else gray = img;
+
+	gray.convertTo(gray32, CV_32F);
+	if (scale < 1.0) resize(gray32, gray32, Size(), scale, scale, INTER_AREA);
+
+	normalize(gray32, gray32, 0, 1, NORM_MINMAX);
+	return gray32;
+}
+
+// Cheap score of the metadata alignment: ECC correlation coefficient between the
+// downscaled reference and the downscaled image warped by H_meta. Pixels that fall
+// outside the warped image are masked out.
+double scoreAlignment(const Mat& refSmall, const Mat& dewarped, const Mat& H_meta, double scale) {
+	Mat movSmall = toEccGray(dewarped, scale);
+	Mat H_small = scaleHomography(H_meta, scale);
+
+	Mat warped, mask;
+	warpPerspective(movSmall, warped, H_small, refSmall.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+	warpPerspective(Mat(movSmall.size(), CV_8U, Scalar(255)), mask, H_small, refSmall.size(), INTER_NEAREST | WARP_INVERSE_MAP);
+
+	return computeECC(refSmall, warped, mask);
+}
+
+
+AlignReference loadReference(vector<ImageInfo>& group, int readFlags, double scale, const CalibOptions& opts) {
+	AlignReference ref;
+
+	for (auto& info : group) {
+		if (abs(info.relX) < 0.001 && abs(info.relY) < 0.001) {
+			cout << info.filename << ", " << info.relX << ", " << info.relY << '\n';
+			ref.info = &info;
+			break;
+		}
+	}
+	if (!ref.info) return ref;
+
+	cout << "  Reference found: " << ref.info->filename << endl;
+	Mat rawRef = readImage(*ref.info, readFlags, scale);
+	if (!rawRef.empty()) {
+		ref.image = undistortImg(rawRef, scale < 1.0 ? scaleInfo(*ref.info, scale) : *ref.info, opts.dewarpOnTheFly);
+		ref.gray = toEccGray(ref.image);
+
+		if (opts.adaptive) {
+			ref.smallScale = min(1.0, double(opts.adaptiveSize) / max(ref.image.cols, ref.image.rows));
+			ref.small = toEccGray(ref.image, ref.smallScale);
+		}
+	}
+	return ref;
+}
+
+// Identifies the physical camera (band) an image comes from
+string bandKey(const ImageInfo& info) {
+	return cv::format("%ux%u|%.2f,%.2f|%.3f,%.3f", info.width, info.height, info.relX, info.relY, info.fx, info.fy);
+}
+
+// Steps B and C: metadata homography, optionally refined with ECC against the reference
+ImagePlan alignImage(const ImageInfo& info, const Mat& dewarped, const AlignReference& ref, const CalibOptions& opts) {
+	ImagePlan plan;
+	plan.info = info;
+
+	// --- STEP B: INITIAL ALIGNMENT (Metadata) ---
+	Mat H_meta = Mat::eye(3, 3, CV_64F);
+	if (info.foundH) {
+		cout << "  Step B: H_meta " << info.filename << endl;
+		H_meta = info.H;
+	} else if (abs(info.relX) > 0.0001 || abs(info.relY) > 0.0001) {
+		// Translation
+		cout << "  Step B: relXY " << info.filename << endl;
+		H_meta.at<double>(0, 2) = info.relX;
+		H_meta.at<double>(1, 2) = info.relY;
+	}
+
+	// --- STEP C: OPTIONAL FINE TUNING (ECC) ---
+	Mat H_total = H_meta.clone();
+
+	cout << "  H_meta: " << H_meta << endl;
+
+	bool hasRef = ref.info && ref.info->path != info.path && !ref.image.empty();
+	int eccIterations = opts.eccIterations;
+	double ccFinal = -1;
+
+	if (hasRef && opts.adaptive) {
+		double ccMeta = scoreAlignment(ref.small, dewarped, H_meta, ref.smallScale);
+		ccFinal = ccMeta;
+
+		const char* decision = "full";
+		if (ccMeta >= opts.adaptiveSkipCC) {
+			eccIterations = 0;
+			decision = "skip";
+		} else if (ccMeta >= opts.adaptiveShortCC) {
+			eccIterations = opts.adaptiveShortIterations;
+			decision = "short";
+		}
+
+		cout << "  Adaptive: " << info.filename << " cc_meta=" << ccMeta << " -> " << decision << " (" << eccIterations << " iterations)" << endl;
+	}
+
+	if (hasRef && eccIterations > 0) {
+		cout << "  Step C: Aligning " << info.filename << " to " << ref.info->filename << " using ECC..." << endl;
+
+		// 1. Apply metadata warp first to get close
+		Mat alignedMeta;
+		warpPerspective(dewarped, alignedMeta, H_meta, dewarped.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+
+		// 2. Prepare images for ECC
+		// Gray CV_32F (ECC requires 8U or 32F), normalized to 0-1 for numerical stability
+		Mat alignedGray = toEccGray(alignedMeta);
+		const Mat& refGray = ref.gray;
+
+		// 3. Run ECC
+
+		// Old Affine conversion logic
+		// int motionType = MOTION_AFFINE;
+		// Mat H_ecc = Mat::eye(2, 3, CV_32F);
+
+		// New Homography
+		int motionType = MOTION_HOMOGRAPHY;
+		Mat H_ecc = Mat::eye(3, 3, CV_32F);
+
+		// Optional: warm start from the correction found for the previous capture of this band.
+		// Takes precedence over phase correlation
+		bool seeded = false;
+		plan.seed = "identity";
+		if (opts.warmStart) {
+			Mat previous;
+			if (g_bandCorrection.get(bandKey(info), previous)) {
+				previous.copyTo(H_ecc);
+				seeded = true;
+				plan.seed = "warmStart";
+				cout << "    Warm start from previous capture of this band" << endl;
+			}
+		}
+
+		TermCriteria criteria(TermCriteria::EPS | TermCriteria::COUNT, eccIterations, 1e-3);
+
+		try {
+			// Optional: seed ECC with the translation found by phase correlation
+			if (opts.phaseCorr && !seeded) {
+				double response = 0;
+				Point2d shift = phaseCorrShift(refGray, alignedGray, opts.phaseCorrSize, &response);
+				cout << "    Phase correlation shift: " << shift << " (response=" << response << ")" << endl;
+
+				if (response >= opts.phaseCorrMinResponse) {
+					H_ecc.at<float>(0, 2) = float(shift.x);
+					H_ecc.at<float>(1, 2) = float(shift.y);
+					plan.seed = "phaseCorr";
+				} else {
+					cout << "    Phase correlation rejected, starting ECC from identity" << endl;
+				}
+			}
+
+			double cc = findTransformECC(refGray, alignedGray, H_ecc, motionType, criteria);
+			cout << "    ECC converged (cc=" << cc << ")" << endl;
+			ccFinal = cc;
+			if (opts.warmStart) g_bandCorrection.put(bandKey(info), H_ecc.clone());
+
+			cout << "  H_ecc: " << H_ecc << endl;
+
+			// 4. Compose transforms
+			// H_meta maps: Dst (Aligned) -> Src (Original)
+			// H_ecc maps: Dst (Ref) -> Src (Aligned)  [Backward mapping for WARP_INVERSE_MAP]
+			// We want: Ref -> Original
+			// H_total = H_meta * H_ecc
+
+			Mat H_ecc_64F;
+			H_ecc.convertTo(H_ecc_64F, CV_64F);
+
+			// Old Affine conversion logic
+			Mat H_ecc_3x3 = Mat::eye(3, 3, CV_64F);
+			H_ecc_3x3.at<double>(0,0) = H_ecc.at<float>(0,0);
+			H_ecc_3x3.at<double>(0,1) = H_ecc.at<float>(0,1);
+			H_ecc_3x3.at<double>(0,2) = H_ecc.at<float>(0,2);
+			H_ecc_3x3.at<double>(1,0) = H_ecc.at<float>(1,0);
+			H_ecc_3x3.at<double>(1,1) = H_ecc.at<float>(1,1);
+			H_ecc_3x3.at<double>(1,2) = H_ecc.at<float>(1,2);
+			H_total = H_meta * H_ecc_3x3;
+
+			// New Homography
+			H_total = H_meta * H_ecc_64F;
+
+		} catch (const cv::Exception& e) {
+			cerr << "    ECC failed: " << e.what() << endl;
+		}
+	}
+
+	cout << "  H_total: " << H_total << endl;
+	if (hasRef && opts.adaptive) cout << "  Final cc: " << info.filename << " " << ccFinal << endl;
+
+	plan.H_total = H_total;
+	plan.cc = ccFinal;
+	return plan;
+}
+
+double outputScale(const ImageInfo& info, const CalibOptions& opts) {
+	if (opts.outSize.area() > 0 && info.width > 0 && info.height > 0) {
+		return min(1.0, min(double(opts.outSize.width) / info.width, double(opts.outSize.height) / info.height));
+	}
+	return opts.outScale;
+}
+
+// Step D: resample the dewarped image into the reference frame and write it.
+// When downscaling, the scale is folded into the dewarp and warp transforms: the raw
+// image is area-filtered once onto the output grid, so dewarp, warp and encode only
+// ever touch output-resolution pixels. `dewarped` may carry an already dewarped
+// full-resolution image to reuse when no scaling is needed.
+bool renderImage(const Mat& raw, const ImagePlan& plan, const CalibOptions& opts, const Mat& dewarped = Mat()) {
+	double scale = outputScale(plan.info, opts);
+
+	Mat finalImg;
+	if (scale < 1.0) {
+		Size outSize(int(lround(raw.cols * scale)), int(lround(raw.rows * scale)));
+		cout << "  Saving " << plan.info.filename << " at " << outSize << endl;
+
+		Mat rawSmall;
+		resize(raw, rawSmall, outSize, 0, 0, INTER_AREA);
+		Mat dewarpedSmall = undistortImg(rawSmall, scaleInfo(plan.info, scale), opts.dewarpOnTheFly);
+		warpPerspective(dewarpedSmall, finalImg, scaleHomography(plan.H_total, scale), outSize, INTER_LINEAR | WARP_INVERSE_MAP);
+	} else {
+		cout << "  Saving " << plan.info.filename << endl;
+
+		Mat full = dewarped.empty() ? undistortImg(raw, plan.info, opts.dewarpOnTheFly) : dewarped;
+		warpPerspective(full, finalImg, plan.H_total, full.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+	}
+	return imwrite(opts.outDir + "/" + plan.info.filename, finalImg);
+}
+
+// Contact sheet of aligned previews, converted to 8-bit BGR and labeled with file names
+Mat makeMosaic(const vector<pair<string, Mat>>& tiles) {
+	if (tiles.empty()) return Mat();
+
+	int cols = int(ceil(sqrt(double(tiles.size()))));
+	int rows = int((tiles.size() + cols - 1) / cols);
+	Size tileSize = tiles[0].second.size();
+
+	Mat mosaic(rows * tileSize.height, cols * tileSize.width, CV_8UC3, Scalar::all(0));
+	for (size_t i = 0; i < tiles.size(); i++) {
+		Mat tile = tiles[i].second;
+		if (tile.depth() != CV_8U) normalize(tile, tile, 0, 255, NORM_MINMAX, CV_8U);
+		if (tile.channels() == 1) cvtColor(tile, tile, COLOR_GRAY2BGR);
+		else if (tile.channels() == 4) cvtColor(tile, tile, COLOR_BGRA2BGR);
+		if (tile.size() != tileSize) resize(tile, tile, tileSize, 0, 0, INTER_AREA);
+
+		Rect roi(int(i % cols) * tileSize.width, int(i / cols) * tileSize.height, tileSize.width, tileSize.height);
+		tile.copyTo(mosaic(roi));
+		putText(mosaic, tiles[i].first, roi.tl() + Point(8, 24), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(0, 255, 255), 2);
+	}
+	return mosaic;
+}
+
+bool writePlan(const string& file, const vector<ImagePlan>& plans) {
+	FileStorage fs(file, FileStorage::WRITE);
+	if (!fs.isOpened()) return false;
+
+	fs << "images" << "[";
+	for (const auto& plan : plans) {
+		const ImageInfo& info = plan.info;
+		fs << "{";
+		fs << "path" << info.path << "filename" << info.filename << "uuid" << info.uuid;
+		fs << "width" << int(info.width) << "height" << int(info.height);
+		fs << "dewarp" << int(info.foundDistortion);
+		fs << "fx" << info.fx << "fy" << info.fy << "cx" << info.cx_d << "cy" << info.cy_d;
+		fs << "k1" << info.k1 << "k2" << info.k2 << "p1" << info.p1 << "p2" << info.p2 << "k3" << info.k3;
+		fs << "calibratedCx" << info.calibratedCx << "calibratedCy" << info.calibratedCy;
+		fs << "H_total" << plan.H_total << "cc" << plan.cc;
+		fs << "}";
+	}
+	fs << "]";
+	return true;
+}
+
+bool readPlan(const string& file, vector<ImagePlan>& plans) {
+	FileStorage fs(file, FileStorage::READ);
+	if (!fs.isOpened()) return false;
+
+	for (const FileNode& node : fs["images"]) {
+		ImagePlan plan;
+		ImageInfo& info = plan.info;
+		int width = 0, height = 0, dewarp = 0;
+
+		node["path"] >> info.path;
+		node["filename"] >> info.filename;
+		node["uuid"] >> info.uuid;
+		node["width"] >> width;
+		node["height"] >> height;
+		node["dewarp"] >> dewarp;
+		node["fx"] >> info.fx; node["fy"] >> info.fy; node["cx"] >> info.cx_d; node["cy"] >> info.cy_d;
+		node["k1"] >> info.k1; node["k2"] >> info.k2; node["p1"] >> info.p1; node["p2"] >> info.p2; node["k3"] >> info.k3;
+		node["calibratedCx"] >> info.calibratedCx;
+		node["calibratedCy"] >> info.calibratedCy;
+		node["H_total"] >> plan.H_total;
+		node["cc"] >> plan.cc;
+
+		info.width = uint32_t(width);
+		info.height = uint32_t(height);
+		info.foundDistortion = dewarp != 0;
+		plans.push_back(plan);
+	}
+	return true;
+}
+
+
 bool usage() {
-	cout << "USAGE: ./calib <src_dir> <dest_dir>" << endl;
+	cout << "USAGE: ./calib [options] <src_dir> <dest_dir>" << endl;
+	cout << "   Or: ./calib [options] --plan <transform_file> <src_dir> (Plan Mode)" << endl;
+	cout << "   Or: ./calib --apply <transform_file> <src_dir> <dest_dir> (Apply Mode)" << endl;
+	cout << "   Or: ./calib [options] --preview <2|4|8> <src_dir> <dest_dir> (QC Preview Mode)" << endl;
+	cout << "Options:" << endl;
+	cout << "  --phase-corr          Seed ECC with an FFT phase-correlation translation" << endl;
+	cout << "  --warm-start          Seed ECC with the last correction found for the same band" << endl;
+	cout << "                        (overrides --phase-corr when available; results then depend" << endl;
+	cout << "                        on processing order, including across daemon jobs)" << endl;
+	cout << "  --adaptive            Score metadata alignment first and skip/shorten ECC" << endl;
+	cout << "  --dewarp-fly          Map-free on-the-fly Brown model dewarp kernel" << endl;
+	cout << "  --bench-dewarp        Benchmark the map-based and on-the-fly dewarp kernels on <src_dir>" << endl;
+	cout << "  --daemon              Serve JSON line jobs from stdin with warm caches (Daemon Mode)" << endl;
+	cout << "  --socket <path>       Serve daemon jobs on a Unix socket instead of stdin" << endl;
+	cout << "  --workers <n>         Jobs processed concurrently in daemon mode" << endl;
+	cout << "  --plan-scale <s>      Align at this fraction of full resolution in plan mode (0-1]" << endl;
+	cout << "  --out-scale <s>       Write outputs at this fraction of full resolution (0-1]" << endl;
+	cout << "  --out-size <W>x<H>    Write outputs fitted inside W x H (keeps aspect ratio)" << endl;
 	cout << "---" << endl;
 
 	return 1;
 }
 
+bool parseArgs(int argc, char** argv, CalibOptions& opts) {
+	vector<string> positional;
 
-int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		string value;
+
+		auto nextValue = [&]() {
+			if (i + 1 >= argc) {
+				cerr << "Missing value for " << arg << endl;
+				return false;
+			}
+			value = argv[++i];
+			return true;
+		};
+
+		// Numeric values must parse completely; bad input is reported by the caller
+		auto toInt = [&](int& out) {
+			try {
+				size_t end = 0;
+				out = stoi(value, &end);
+				return end == value.size();
+			} catch (const exception&) {
+				return false;
+			}
+		};
+		auto toDouble = [&](double& out) {
+			try {
+				size_t end = 0;
+				out = stod(value, &end);
+				return end == value.size();
+			} catch (const exception&) {
+				return false;
+			}
+		};
+
+		if (arg == "--phase-corr") {
+			opts.phaseCorr = true;
+		} else if (arg == "--warm-start") {
+			opts.warmStart = true;
+		} else if (arg == "--adaptive") {
+			opts.adaptive = true;
+		} else if (arg == "--dewarp-fly") {
+			opts.dewarpOnTheFly = true;
+		} else if (arg == "--bench-dewarp") {
+			opts.mode = CalibMode::BenchDewarp;
+		} else if (arg == "--daemon") {
+			opts.mode = CalibMode::Daemon;
+		} else if (arg == "--socket") {
+			if (!nextValue()) return false;
+			opts.mode = CalibMode::Daemon;
+			opts.socketPath = value;
+		} else if (arg == "--workers") {
+			if (!nextValue()) return false;
+			if (!toInt(opts.workers) || opts.workers < 1) {
+				cerr << "Invalid --workers: " << value << endl;
+				return false;
+			}
+		} else if (arg == "--plan") {
+			if (!nextValue()) return false;
+			opts.mode = CalibMode::Plan;
+			opts.planFile = value;
+		} else if (arg == "--apply") {
+			if (!nextValue()) return false;
+			opts.mode = CalibMode::Apply;
+			opts.planFile = value;
+		} else if (arg == "--preview") {
+			if (!nextValue()) return false;
+			opts.mode = CalibMode::Preview;
+			if (!toInt(opts.previewFactor) || (opts.previewFactor != 2 && opts.previewFactor != 4 && opts.previewFactor != 8)) {
+				cerr << "Invalid --preview factor: " << value << endl;
+				return false;
+			}
+		} else if (arg == "--plan-scale") {
+			if (!nextValue()) return false;
+			if (!toDouble(opts.planScale) || opts.planScale <= 0 || opts.planScale > 1) {
+				cerr << "Invalid --plan-scale: " << value << endl;
+				return false;
+			}
+		} else if (arg == "--out-scale") {
+			if (!nextValue()) return false;
+			if (!toDouble(opts.outScale) || opts.outScale <= 0 || opts.outScale > 1) {
+				cerr << "Invalid --out-scale: " << value << endl;
+				return false;
+			}
+		} else if (arg == "--out-size") {
+			if (!nextValue()) return false;
+			int w = 0, h = 0;
+			if (sscanf(value.c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+				cerr << "Invalid --out-size: " << value << endl;
+				return false;
+			}
+			opts.outSize = Size(w, h);
+		} else if (arg.rfind("--", 0) == 0) {
+			cerr << "Unknown option: " << arg << endl;
+			return false;
+		} else {
+			positional.push_back(arg);
+		}
+	}
+
+	if (positional.size() > 0) opts.inDir = positional[0];
+	if (positional.size() > 1) opts.outDir = positional[1];
+
+	return true;
+}
+
+// Compare the dewarp kernels on every image with DewarpData, for 8U/16U and 1/3 channel
+// variants of it: cv::undistort (map built on every call), remap with precomputed float
+// and fixed-point tables (only the lookup is timed) and the on-the-fly kernel
+int runBenchDewarp(const vector<ImageInfo>& images, const CalibOptions& opts) {
+	auto timeMs = [&](const function<void()>& fn) {
+		vector<double> times;
+		for (int i = 0; i < opts.benchRepeats; i++) {
+			auto tik = chrono::high_resolution_clock::now();
+			fn();
+			auto tok = chrono::high_resolution_clock::now();
+			times.push_back(chrono::duration<double, milli>(tok - tik).count());
+		}
+		sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	};
+
+	for (const auto& info : images) {
+		if (!info.foundDistortion) continue;
+
+		Mat raw = readImage(info, READ_FULL);
+		if (raw.empty()) continue;
+
+		Mat gray8, color8;
+		if (raw.channels() > 1) cvtColor(raw, gray8, COLOR_BGR2GRAY);
+		else gray8 = raw;
+		if (gray8.depth() != CV_8U) normalize(gray8, gray8, 0, 255, NORM_MINMAX, CV_8U);
+		cvtColor(gray8, color8, COLOR_GRAY2BGR);
+
+		vector<pair<string, Mat>> variants = { { "8UC1", gray8 }, { "8UC3", color8 } };
+		Mat gray16, color16;
+		gray8.convertTo(gray16, CV_16U, 257);
+		color8.convertTo(color16, CV_16U, 257);
+		variants.emplace_back("16UC1", gray16);
+		variants.emplace_back("16UC3", color16);
+
+		cout << info.filename << " (" << raw.cols << "x" << raw.rows << ", median of " << opts.benchRepeats << ")" << endl;
+
+		// Tables are built once, outside the timed code
+		Mat K, D, mapX32, mapY32, map16, mapInterp;
+		dewarpParams(info, K, D);
+		initUndistortRectifyMap(K, D, Mat(), K, raw.size(), CV_32FC1, mapX32, mapY32);
+		initUndistortRectifyMap(K, D, Mat(), K, raw.size(), CV_16SC2, map16, mapInterp);
+
+		for (const auto& variant : variants) {
+			const Mat& img = variant.second;
+			Mat byUndistort, byMap32, byMap16, byFly;
+			double undistortMs = timeMs([&]() { undistort(img, byUndistort, K, D, K); });
+			double map32Ms = timeMs([&]() { remap(img, byMap32, mapX32, mapY32, INTER_LINEAR, BORDER_CONSTANT); });
+			double map16Ms = timeMs([&]() { remap(img, byMap16, map16, mapInterp, INTER_LINEAR, BORDER_CONSTANT); });
+			double flyMs = timeMs([&]() { byFly = undistortImg(img, info, true); });
+
+			double maxDiff = 0;
+			Mat diff;
+			absdiff(byMap32, byFly, diff);
+			minMaxLoc(diff.reshape(1), nullptr, &maxDiff);
+
+			cout << "  " << variant.first << "  undistort: " << undistortMs << " ms  remap 32F: " << map32Ms
+				<< " ms  remap 16S: " << map16Ms << " ms  on-the-fly: " << flyMs << " ms  speedup vs remap 32F: "
+				<< map32Ms / flyMs << "x  vs remap 16S: " << map16Ms / flyMs << "x  max diff: " << maxDiff << endl;
+		}
+	}
+	return 0;
+}
+
+int runApply(const CalibOptions& opts, CalibStats& stats) {
+	vector<ImagePlan> plans;
+	if (!readPlan(opts.planFile, plans)) {
+		cerr << "Error: Could not read transform file " << opts.planFile << endl;
+		return 1;
+	}
 
-	string inDir = (argc > 1) ? argv[1] : "input";
-	string outDir = (argc > 2) ? argv[2] : "output";
+	cout << "Applying " << plans.size() << " transforms from " << opts.planFile << endl;
+	create_directories(opts.outDir);
 
-	if (!exists(inDir)) return usage();
+	for (const auto& plan : plans) {
+		cout << "  --- " << endl;
+
+		// Prefer the file in <src_dir>, so plans can be applied on another machine
+		ImageInfo info = plan.info;
+		path local = path(opts.inDir) / info.filename;
+		if (exists(local)) info.path = local.string();
+
+		Mat raw = readImage(info, READ_FULL);
+		if (raw.empty()) {
+			cerr << "  Failed to read image: " << info.path << endl;
+			stats.failed++;
+			continue;
+		}
+
+		if (renderImage(raw, plan, opts)) stats.images++;
+		else stats.failed++;
+	}
+	return 0;
+}
+
+
+int runCalib(const CalibOptions& opts, CalibStats& stats) {
+	if (opts.mode == CalibMode::Apply) return runApply(opts, stats);
+
+	const string& inDir = opts.inDir;
+	const string& outDir = opts.outDir;
+
+	if (!exists(inDir)) {
+		cerr << "Error: Source directory '" << inDir << "' not found." << endl;
+		return 1;
+	}
 
 	cout << "UAV Calibration running" << endl;
-	create_directories(outDir);
+	if (opts.mode != CalibMode::Plan && opts.mode != CalibMode::BenchDewarp) create_directories(outDir);
 
 	vector<ImageInfo> allImages;
 	cout << "Scanning " << inDir << "..." << endl;
@@ -254,6 +1197,8 @@ int main(int argc, char** argv) {
 		allImages.push_back(parseMetadata(path));
 	}
 
+	if (opts.mode == CalibMode::BenchDewarp) return runBenchDewarp(allImages, opts);
+
 	// Group by UUID
 	map<string, vector<ImageInfo>> groups;
 	for (const auto& info : allImages) {
@@ -264,132 +1209,402 @@ int main(int argc, char** argv) {
 		}
 	}
 
+	// Plan mode only needs gray data, optionally at reduced resolution.
+	// Preview mode decodes, aligns and resamples everything at 1/previewFactor.
+	bool planOnly = opts.mode == CalibMode::Plan;
+	bool preview = opts.mode == CalibMode::Preview;
+	int readFlags = planOnly ? READ_GRAY : READ_FULL;
+	double alignScale = planOnly ? opts.planScale : preview ? 1.0 / opts.previewFactor : 1.0;
+	vector<ImagePlan> plans;
+
 	for (auto& [uuid, group] : groups) {
 		cout << "Processing group: " << uuid << " (" << group.size() << " images)" << endl;
 
-		ImageInfo* refInfo = nullptr;
-		Mat refMat;
-
-		for (auto& info : group) {
-			if (abs(info.relX) < 0.001 && abs(info.relY) < 0.001) {
-				cout << info.filename << ", " << info.relX << ", " << info.relY << '\n';
-				refInfo = &info;
-				break;
-			}
-		}
-
-		if (refInfo) {
-			cout << "  Reference found: " << refInfo->filename << endl;
-			Mat rawRef = imread(refInfo->path, IMREAD_UNCHANGED | IMREAD_ANYDEPTH | IMREAD_ANYCOLOR);
-			if (!rawRef.empty()) {
-				refMat = undistortImg(rawRef, *refInfo);
-			}
-		} else {
+		AlignReference ref = loadReference(group, readFlags, alignScale, opts);
+		if (!ref.info) {
 			cout << "  No reference image found for group " << uuid << endl;
 		}
 
+		vector<pair<string, Mat>> previews;
+
 		for (auto& info : group) {
 			cout << "  --- " << endl;
 
-			Mat raw = imread(info.path, IMREAD_UNCHANGED | IMREAD_ANYDEPTH | IMREAD_ANYCOLOR);
-			if (raw.empty()) continue;
+			Mat raw = readImage(info, readFlags, alignScale);
+			if (raw.empty()) {
+				stats.failed++;
+				continue;
+			}
+
+			ImageInfo alignInfo = alignScale < 1.0 ? scaleInfo(info, alignScale) : info;
 
 			// --- STEP A: DEWARP ALIGNMENT (Metadata) ---
 			cout << "  Step A " << info.filename << endl;
-			Mat dewarped = undistortImg(raw, info);
-			Mat finalImg;
-
-			// --- STEP B: INITIAL ALIGNMENT (Metadata) ---
-			Mat H_meta = Mat::eye(3, 3, CV_64F);
-			if (info.foundH) {
-				cout << "  Step B: H_meta " << info.filename << endl;
-				H_meta = info.H;
-			} else if (abs(info.relX) > 0.0001 || abs(info.relY) > 0.0001) {
-				// Translation
-				cout << "  Step B: relXY " << info.filename << endl;
-				H_meta.at<double>(0, 2) = info.relX;
-				H_meta.at<double>(1, 2) = info.relY;
+			Mat dewarped = undistortImg(raw, alignInfo, opts.dewarpOnTheFly);
+
+			// --- STEPS B, C ---
+			ImagePlan plan = alignImage(alignInfo, dewarped, ref, opts);
+			if (!plan.seed.empty()) stats.seeds[plan.seed]++;
+
+			if (preview) {
+				Mat aligned;
+				warpPerspective(dewarped, aligned, plan.H_total, dewarped.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+				previews.emplace_back(info.filename, aligned);
+				stats.images++;
+				continue;
 			}
 
-			// --- STEP C: OPTIONAL FINE TUNING (ECC) ---
-			Mat H_total = H_meta.clone();
+			if (!planOnly) {
+				if (renderImage(raw, plan, opts, dewarped)) stats.images++;
+				else stats.failed++;
+				continue;
+			}
 
-			cout << "  H_meta: " << H_meta << endl;
+			// Back to full resolution for the apply phase
+			plan.info = info;
+			plan.H_total = scaleHomography(plan.H_total, 1.0 / alignScale);
+			plans.push_back(plan);
+			stats.images++;
+		}
 
-			if (refInfo && refInfo->path != info.path && !refMat.empty()) {
-				cout << "  Step C: Aligning " << info.filename << " to " << refInfo->filename << " using ECC..." << endl;
+		if (preview && !previews.empty()) {
+			string mosaicPath = outDir + "/" + uuid + "_preview.jpg";
+			cout << "  Saving preview " << mosaicPath << endl;
+			imwrite(mosaicPath, makeMosaic(previews));
+		}
+	}
 
-				// 1. Apply metadata warp first to get close
-				Mat alignedMeta;
-				warpPerspective(dewarped, alignedMeta, H_meta, dewarped.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+	if (planOnly) {
+		if (!writePlan(opts.planFile, plans)) {
+			cerr << "Error: Could not write transform file " << opts.planFile << endl;
+			return 1;
+		}
+		cout << "Wrote " << plans.size() << " transforms to " << opts.planFile << endl;
+	}
+	return 0;
+}
 
-				// 2. Prepare images for ECC
-				Mat alignedGray, refGray;
-				if (alignedMeta.channels() > 1) cvtColor(alignedMeta, alignedGray, COLOR_BGR2GRAY);
-				else alignedGray = alignedMeta.clone();
 
-				if (refMat.channels() > 1) cvtColor(refMat, refGray, COLOR_BGR2GRAY);
-				else refGray = refMat.clone();
+// --- DAEMON MODE ---
+// Jobs are JSON objects, one per line, e.g.
+//   {"id": "b1", "src": "in", "dest": "out", "mode": "run", "adaptive": true, "outScale": 0.5}
+// Fields that are not given fall back to the daemon's command line options. Every job is
+// answered with one JSON line: {"id": "b1", "ok": true, "images": 6, "failed": 0, "ms": 1234}
+// Logs go to stderr, so stdout only carries results.
+
+string jsonEscape(const string& s) {
+	string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (c == '\n') {
+			out += "\\n";
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out += cv::format("\\u%04x", c);
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
 
-				// Convert to CV_32F for ECC (required: 8U or 32F)
-				if (alignedGray.depth() != CV_32F) alignedGray.convertTo(alignedGray, CV_32F);
-				if (refGray.depth() != CV_32F) refGray.convertTo(refGray, CV_32F);
+// Booleans are read as ints: map true/false outside of strings to 1/0
+string normalizeJsonBools(const string& json) {
+	string out;
+	bool inString = false;
+	for (size_t i = 0; i < json.size(); i++) {
+		char c = json[i];
+		if (inString) {
+			if (c == '\\' && i + 1 < json.size()) {
+				out += c;
+				c = json[++i];
+			} else if (c == '"') {
+				inString = false;
+			}
+		} else if (c == '"') {
+			inString = true;
+		} else if (json.compare(i, 4, "true") == 0) {
+			out += '1';
+			i += 3;
+			continue;
+		} else if (json.compare(i, 5, "false") == 0) {
+			out += '0';
+			i += 4;
+			continue;
+		}
+		out += c;
+	}
+	return out;
+}
 
-				// Optional: Normalize to 0-1 range for better numerical stability with ECC
-				normalize(alignedGray, alignedGray, 0, 1, NORM_MINMAX);
-				normalize(refGray, refGray, 0, 1, NORM_MINMAX);
+bool parseJob(const string& line, CalibOptions& opts, string& id, string& error) {
+	FileStorage fs(normalizeJsonBools(line), FileStorage::READ | FileStorage::MEMORY | FileStorage::FORMAT_JSON);
+	if (!fs.isOpened()) {
+		error = "invalid job";
+		return false;
+	}
 
-				// 3. Run ECC
+	FileNode idNode = fs["id"];
+	if (idNode.isString()) id = (string)idNode;
+	else if (idNode.isInt()) id = to_string((int)idNode);
+
+	auto str = [&](const char* key, string& out) {
+		FileNode node = fs[key];
+		if (node.isString()) out = (string)node;
+	};
+	auto num = [&](const char* key, double& out) {
+		FileNode node = fs[key];
+		if (node.isInt() || node.isReal()) out = (double)node;
+	};
+	auto flag = [&](const char* key, bool& out) {
+		FileNode node = fs[key];
+		if (node.isInt()) out = (int)node != 0;
+	};
+
+	string mode = "run";
+	str("mode", mode);
+	str("src", opts.inDir);
+	str("dest", opts.outDir);
+	str("plan", opts.planFile);
+	num("planScale", opts.planScale);
+	num("outScale", opts.outScale);
+	flag("adaptive", opts.adaptive);
+	flag("phaseCorr", opts.phaseCorr);
+	flag("dewarpFly", opts.dewarpOnTheFly);
+	flag("warmStart", opts.warmStart);
+
+	double outWidth = 0, outHeight = 0, previewFactor = opts.previewFactor;
+	num("outWidth", outWidth);
+	num("outHeight", outHeight);
+	num("preview", previewFactor);
+	if (outWidth > 0 && outHeight > 0) opts.outSize = Size(int(outWidth), int(outHeight));
+	opts.previewFactor = int(previewFactor);
+
+	if (mode == "run") opts.mode = CalibMode::Run;
+	else if (mode == "plan") opts.mode = CalibMode::Plan;
+	else if (mode == "apply") opts.mode = CalibMode::Apply;
+	else if (mode == "preview") opts.mode = CalibMode::Preview;
+	else error = "unknown mode: " + mode;
+
+	if (error.empty() && (opts.mode == CalibMode::Plan || opts.mode == CalibMode::Apply) && opts.planFile.empty()) error = "missing plan";
+	if (error.empty() && (opts.planScale <= 0 || opts.planScale > 1)) error = "invalid planScale";
+	if (error.empty() && (opts.outScale <= 0 || opts.outScale > 1)) error = "invalid outScale";
+	if (error.empty() && opts.previewFactor != 2 && opts.previewFactor != 4 && opts.previewFactor != 8) error = "invalid preview";
+
+	return error.empty();
+}
 
-				// Old Affine conversion logic
-				// int motionType = MOTION_AFFINE;
-				// Mat H_ecc = Mat::eye(2, 3, CV_32F);
+string runJob(const string& line, const CalibOptions& defaults) {
+	auto tik = chrono::high_resolution_clock::now();
 
-				// New Homography
-				int motionType = MOTION_HOMOGRAPHY;
-				Mat H_ecc = Mat::eye(3, 3, CV_32F);
+	CalibOptions opts = defaults;
+	opts.mode = CalibMode::Run;
+	CalibStats stats;
+	string id, error;
+	bool ok = false;
 
-				TermCriteria criteria(TermCriteria::EPS | TermCriteria::COUNT, 50, 1e-3);
+	try {
+		if (parseJob(line, opts, id, error)) {
+			ok = runCalib(opts, stats) == 0;
+			if (!ok) error = "job failed";
+		}
+	} catch (const exception& e) {
+		error = e.what();
+	}
+
+	auto tok = chrono::high_resolution_clock::now();
+
+	ostringstream out;
+	out << "{\"id\":\"" << jsonEscape(id) << "\",\"ok\":" << (ok ? "true" : "false")
+		<< ",\"images\":" << stats.images << ",\"failed\":" << stats.failed
+		<< ",\"ms\":" << chrono::duration_cast<chrono::milliseconds>(tok - tik).count()
+		<< ",\"warmStart\":" << (opts.warmStart ? "true" : "false") << ",\"seeds\":{";
+	for (auto it = stats.seeds.begin(); it != stats.seeds.end(); ++it) {
+		out << (it == stats.seeds.begin() ? "" : ",") << "\"" << it->first << "\":" << it->second;
+	}
+	out << "}";
+	if (!ok) out << ",\"error\":\"" << jsonEscape(error) << "\"";
+	out << "}";
+	return out.str();
+}
+
+struct Job {
+	string line;
+	function<void(const string&)> reply;
+};
 
-				try {
-					double cc = findTransformECC(refGray, alignedGray, H_ecc, motionType, criteria);
-					cout << "    ECC converged (cc=" << cc << ")" << endl;
+class JobQueue {
+public:
+	void push(Job job) {
+		lock_guard<mutex> lock(mtx);
+		jobs.push(move(job));
+		cond.notify_one();
+	}
 
-					cout << "  H_ecc: " << H_ecc << endl;
+	// Blocks until a job is available; false once the queue is closed and drained
+	bool pop(Job& job) {
+		unique_lock<mutex> lock(mtx);
+		cond.wait(lock, [&]() { return closed || !jobs.empty(); });
+		if (jobs.empty()) return false;
+		job = move(jobs.front());
+		jobs.pop();
+		return true;
+	}
 
-					// 4. Compose transforms
-					// H_meta maps: Dst (Aligned) -> Src (Original)
-					// H_ecc maps: Dst (Ref) -> Src (Aligned)  [Backward mapping for WARP_INVERSE_MAP]
-					// We want: Ref -> Original
-					// H_total = H_meta * H_ecc
+	void close() {
+		lock_guard<mutex> lock(mtx);
+		closed = true;
+		cond.notify_all();
+	}
 
-					Mat H_ecc_64F;
-					H_ecc.convertTo(H_ecc_64F, CV_64F);
+private:
+	mutex mtx;
+	condition_variable cond;
+	queue<Job> jobs;
+	bool closed = false;
+};
 
-					// Old Affine conversion logic
-					Mat H_ecc_3x3 = Mat::eye(3, 3, CV_64F);
-					H_ecc_3x3.at<double>(0,0) = H_ecc.at<float>(0,0);
-					H_ecc_3x3.at<double>(0,1) = H_ecc.at<float>(0,1);
-					H_ecc_3x3.at<double>(0,2) = H_ecc.at<float>(0,2);
-					H_ecc_3x3.at<double>(1,0) = H_ecc.at<float>(1,0);
-					H_ecc_3x3.at<double>(1,1) = H_ecc.at<float>(1,1);
-					H_ecc_3x3.at<double>(1,2) = H_ecc.at<float>(1,2);
-					H_total = H_meta * H_ecc_3x3;
+#ifndef _WIN32
+// One socket client: jobs are read line by line and answered on the same connection,
+// which is closed once the client hung up and every reply has been written
+struct SocketClient {
+	int fd;
+	mutex mtx;
+
+	explicit SocketClient(int fd) : fd(fd) {}
+	~SocketClient() { ::close(fd); }
+
+	void reply(const string& result) {
+		lock_guard<mutex> lock(mtx);
+		string data = result + "\n";
+		size_t sent = 0;
+		while (sent < data.size()) {
+			ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+			if (n <= 0) return;
+			sent += size_t(n);
+		}
+	}
+};
 
-					// New Homography
-					H_total = H_meta * H_ecc_64F;
+void serveClient(int fd, JobQueue& jobs) {
+	auto client = make_shared<SocketClient>(fd);
+	string buffer;
+	char chunk[4096];
+
+	while (true) {
+		ssize_t n = ::read(fd, chunk, sizeof(chunk));
+		if (n <= 0) break;
+		buffer.append(chunk, size_t(n));
+
+		size_t eol;
+		while ((eol = buffer.find('\n')) != string::npos) {
+			string line = buffer.substr(0, eol);
+			buffer.erase(0, eol + 1);
+			if (line.find_first_not_of(" \t\r") == string::npos) continue;
+			jobs.push({ line, [client](const string& result) { client->reply(result); } });
+		}
+	}
+}
 
-				} catch (const cv::Exception& e) {
-					cerr << "    ECC failed: " << e.what() << endl;
-				}
-			}
+int serveSocket(const string& socketPath, JobQueue& jobs) {
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(addr.sun_path)) {
+		cerr << "Error: Socket path too long: " << socketPath << endl;
+		return 1;
+	}
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	// Only a stale socket from a previous run is replaced, never another kind of file
+	struct stat existing;
+	if (::lstat(socketPath.c_str(), &existing) == 0) {
+		if (!S_ISSOCK(existing.st_mode)) {
+			cerr << "Error: " << socketPath << " exists and is not a socket" << endl;
+			return 1;
+		}
+		::unlink(socketPath.c_str());
+	}
 
-			cout << "  H_total: " << H_total << endl;
-			cout << "  Saving " << info.filename << endl;
+	int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || ::bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(server, 8) < 0) {
+		cerr << "Error: Could not listen on " << socketPath << endl;
+		if (server >= 0) ::close(server);
+		return 1;
+	}
 
-			warpPerspective(dewarped, finalImg, H_total, dewarped.size(), INTER_LINEAR | WARP_INVERSE_MAP);
-			imwrite(outDir + "/" + info.filename, finalImg);
+	cerr << "Listening on " << socketPath << endl;
+	while (true) {
+		int fd = ::accept(server, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR) continue;
+			break;
 		}
+		thread(serveClient, fd, std::ref(jobs)).detach();
 	}
+
+	::close(server);
+	::unlink(socketPath.c_str());
 	return 0;
-}
\ No newline at end of file
+}
+#endif
+
+// Long running service: lens maps (and, with --warm-start, per-band ECC corrections) stay warm across jobs,
+// which run on a pool of `workers` threads
+int runDaemon(const CalibOptions& opts) {
+	ostream results(cout.rdbuf());
+	cout.rdbuf(cerr.rdbuf());
+	mutex resultsMtx;
+
+	CalibOptions defaults = opts;
+	g_warmDewarpMaps = true;
+
+	JobQueue jobs;
+	vector<thread> workers;
+	for (int i = 0; i < max(1, opts.workers); i++) {
+		workers.emplace_back([&]() {
+			Job job;
+			while (jobs.pop(job)) job.reply(runJob(job.line, defaults));
+		});
+	}
+	cerr << "Daemon ready (" << workers.size() << " workers)" << endl;
+
+	int ret = 0;
+	if (!opts.socketPath.empty()) {
+#ifndef _WIN32
+		signal(SIGPIPE, SIG_IGN);
+		ret = serveSocket(opts.socketPath, jobs);
+#else
+		cerr << "Error: --socket is not supported on Windows, use stdin" << endl;
+		ret = 1;
+#endif
+	} else {
+		string line;
+		while (getline(cin, line)) {
+			if (line.find_first_not_of(" \t\r") == string::npos) continue;
+			jobs.push({ line, [&](const string& result) {
+				lock_guard<mutex> lock(resultsMtx);
+				results << result << endl;
+			} });
+		}
+	}
+
+	jobs.close();
+	for (auto& worker : workers) worker.join();
+
+	cout.rdbuf(results.rdbuf());
+	return ret;
+}
+
+
+int main(int argc, char** argv) {
+
+	CalibOptions opts;
+	if (!parseArgs(argc, argv, opts)) return usage();
+
+	if (opts.mode == CalibMode::Daemon) return runDaemon(opts);
+	if (opts.mode != CalibMode::Apply && !exists(opts.inDir)) return usage();
+
+	CalibStats stats;
+	return runCalib(opts, stats);
+}
@@ -0,0 +1,73 @@
+#ifndef UAV_CALIB_CHESSBOARD_H
+#define UAV_CALIB_CHESSBOARD_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Chessboard corner detection shared by the fisheye CLI and the Node addon
+
+inline cv::TermCriteria chessboardSubpixCriteria() {
+	return cv::TermCriteria(cv::TermCriteria::EPS | cv::TermCriteria::MAX_ITER, 30, 0.1);
+}
+
+// Full resolution detection followed by cornerSubPix
+inline bool detectChessboard(const cv::Mat& gray, cv::Size checkboardSize, cv::Mat& corners) {
+	// Use CALIB_CB_ADAPTIVE_THRESH for better robustness
+	bool found = cv::findChessboardCorners(gray, checkboardSize, corners,
+		cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE);
+
+	if (found) {
+		cv::cornerSubPix(gray, corners, cv::Size(3, 3), cv::Size(-1, -1), chessboardSubpixCriteria());
+	}
+	return found;
+}
+
+// Coarse-to-fine detection: the board is searched on a copy downscaled to `coarseSide`
+// pixels on its longest side, so samples without a board are rejected at low resolution.
+// Found corners are mapped back and refined with cornerSubPix at full resolution, in a
+// window just large enough to cover the coarse localization error. Images that are
+// already small take the full resolution path.
+inline bool detectChessboardCoarseToFine(const cv::Mat& gray, cv::Size checkboardSize, cv::Mat& corners, int coarseSide) {
+	double scale = std::min(1.0, double(coarseSide) / std::max(gray.cols, gray.rows));
+	if (coarseSide <= 0 || scale >= 0.75) return detectChessboard(gray, checkboardSize, corners);
+
+	cv::Mat small;
+	cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+	if (!cv::findChessboardCorners(small, checkboardSize, corners,
+			cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE)) {
+		return false;
+	}
+
+	// Pixel centers: x_full = (x_small + 0.5) / scale - 0.5
+	corners.convertTo(corners, CV_32F, 1.0 / scale, 0.5 / scale - 0.5);
+
+	// Half window: a couple of coarse pixels, but well inside one board square
+	const cv::Point2f* pts = corners.ptr<cv::Point2f>();
+	float square = float(cv::norm(pts[0] - pts[1]));
+	int win = std::max(3, std::min(int(std::ceil(2.0 / scale)), int(square * 0.4f)));
+
+	cv::cornerSubPix(gray, corners, cv::Size(win, win), cv::Size(-1, -1), chessboardSubpixCriteria());
+	return true;
+}
+
+// Mean and max distance between two corner sets of the same board
+inline void cornerDisplacement(const cv::Mat& a, const cv::Mat& b, double& meanDist, double& maxDist) {
+	meanDist = 0;
+	maxDist = 0;
+
+	int n = int(std::min(a.total(), b.total()));
+	const cv::Point2f* pa = a.ptr<cv::Point2f>();
+	const cv::Point2f* pb = b.ptr<cv::Point2f>();
+	for (int i = 0; i < n; i++) {
+		double d = cv::norm(pa[i] - pb[i]);
+		meanDist += d;
+		maxDist = std::max(maxDist, d);
+	}
+	if (n > 0) meanDist /= n;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <opencv2/calib3d.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -11,6 +12,21 @@
 #include <string>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "chessboard.h"
 
 using namespace std;
 using namespace filesystem;
@@ -36,6 +52,884 @@ vector<Point3f> calibratePattern(Size checkboardSize, float squareSize) {
 	return ret;
 }
 
+// Corners found in one calibration sample
+struct SampleCorners {
+	string path;
+	Size size;
+	bool loaded = false;
+	bool found = false;
+	Mat corners;
+	long long ms = 0;
+
+	// Variance of the Laplacian over the board, used to rank views
+	double sharpness = 0;
+
+	// Corner cache
+	string hash;
+	bool cached = false;
+
+	// --validate-corners: coarse-to-fine vs full resolution corners
+	bool validated = false;
+	double diffMean = 0, diffMax = 0;
+};
+
+struct DetectOptions {
+	int coarseSide = 0;             // Coarse-to-fine detection on this longest side, 0 = off
+	bool validate = false;          // Also run the full resolution path and compare
+	bool useCache = true;           // Reuse corners from the samples directory cache
+	int maxViews = 0;               // Calibrate on at most this many selected views, 0 = all
+};
+
+double boardSharpness(const Mat& gray, const Mat& corners) {
+	Rect roi = boundingRect(corners) & Rect(0, 0, gray.cols, gray.rows);
+	if (roi.area() == 0) return 0;
+
+	Mat lap;
+	Laplacian(gray(roi), lap, CV_32F);
+	Scalar mean, stddev;
+	meanStdDev(lap, mean, stddev);
+	return stddev[0] * stddev[0];
+}
+
+// --- CORNER CACHE ---
+// Refined corners per sample, stored in the samples directory and keyed by file content
+// hash, board size and detector, so recalibration only detects new or changed images.
+
+const char* CORNER_CACHE_FILE = ".corners_cache.yml";
+// Bump when the stored fields change, so entries written by older versions miss
+// (2: board sharpness)
+const int CORNER_CACHE_VERSION = 2;
+
+struct CachedCorners {
+	bool found = false;
+	Size size;
+	Mat corners;
+	double sharpness = 0;
+};
+
+typedef map<string, CachedCorners> CornerCache;
+
+bool readFileBytes(const string& file, vector<uchar>& bytes) {
+	ifstream in(file, ios::binary);
+	if (!in.is_open()) return false;
+	bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	return true;
+}
+
+// FNV-1a 64-bit
+string hashBytes(const vector<uchar>& bytes) {
+	uint64_t h = 14695981039346656037ULL;
+	for (uchar b : bytes) {
+		h ^= b;
+		h *= 1099511628211ULL;
+	}
+	return cv::format("%016llx", (unsigned long long)h);
+}
+
+string cornerCacheKey(const string& hash, Size checkboardSize, const DetectOptions& detect) {
+	return cv::format("v%d|%s|%dx%d|%d", CORNER_CACHE_VERSION, hash.c_str(), checkboardSize.width, checkboardSize.height, detect.coarseSide);
+}
+
+void loadCornerCache(const string& file, CornerCache& cache) {
+	if (!exists(file)) return;
+
+	try {
+		FileStorage fs(file, FileStorage::READ);
+		for (const FileNode& node : fs["samples"]) {
+			CachedCorners entry;
+			entry.found = (int)node["found"] != 0;
+			entry.size = Size((int)node["width"], (int)node["height"]);
+			if (entry.found) node["corners"] >> entry.corners;
+			node["sharpness"] >> entry.sharpness;
+			cache[(string)node["key"]] = entry;
+		}
+	} catch (const cv::Exception& e) {
+		cerr << "Ignoring unreadable corner cache " << file << ": " << e.what() << endl;
+		cache.clear();
+	}
+}
+
+bool saveCornerCache(const string& file, const vector<SampleCorners>& samples, Size checkboardSize, const DetectOptions& detect) {
+	FileStorage fs(file, FileStorage::WRITE);
+	if (!fs.isOpened()) return false;
+
+	fs << "samples" << "[";
+	for (const auto& sample : samples) {
+		if (!sample.loaded || sample.hash.empty()) continue;
+		fs << "{";
+		fs << "key" << cornerCacheKey(sample.hash, checkboardSize, detect);
+		fs << "file" << path(sample.path).filename().string();
+		fs << "found" << int(sample.found);
+		fs << "width" << sample.size.width << "height" << sample.size.height;
+		if (sample.found) fs << "corners" << sample.corners << "sharpness" << sample.sharpness;
+		fs << "}";
+	}
+	fs << "]";
+	return true;
+}
+
+// Decode, detect and refine every sample as a parallel stream on OpenCV's thread pool.
+// Each worker releases its image as soon as the corners are found, so at most one
+// decoded frame per thread is alive. Results keep the order of `files`.
+// Samples whose content hash is in `cache` are not decoded at all.
+vector<SampleCorners> detectSamples(const vector<string>& files, Size checkboardSize, const DetectOptions& detect, const CornerCache& cache) {
+	vector<SampleCorners> samples(files.size());
+
+	parallel_for_(Range(0, int(files.size())), [&](const Range& range) {
+		for (int i = range.start; i < range.end; i++) {
+			SampleCorners& sample = samples[i];
+			sample.path = files[i];
+
+			auto tik = chrono::high_resolution_clock::now();
+			vector<uchar> bytes;
+			if (!readFileBytes(sample.path, bytes)) continue;
+			sample.hash = hashBytes(bytes);
+
+			auto hit = cache.find(cornerCacheKey(sample.hash, checkboardSize, detect));
+			if (hit != cache.end() && !detect.validate) {
+				sample.loaded = true;
+				sample.cached = true;
+				sample.found = hit->second.found;
+				sample.size = hit->second.size;
+				sample.corners = hit->second.corners;
+				sample.sharpness = hit->second.sharpness;
+				continue;
+			}
+
+			Mat img = imdecode(bytes, IMREAD_GRAYSCALE);
+			bytes = vector<uchar>();
+			if (img.empty()) continue;
+
+			sample.loaded = true;
+			sample.size = img.size();
+			sample.found = detectChessboardCoarseToFine(img, checkboardSize, sample.corners, detect.coarseSide);
+			if (sample.found) sample.sharpness = boardSharpness(img, sample.corners);
+
+			auto tok = chrono::high_resolution_clock::now();
+			sample.ms = chrono::duration_cast<chrono::milliseconds>(tok - tik).count();
+
+			Mat fullCorners;
+			if (detect.validate && sample.found && detectChessboard(img, checkboardSize, fullCorners)) {
+				cornerDisplacement(sample.corners, fullCorners, sample.diffMean, sample.diffMax);
+				sample.validated = true;
+			}
+		}
+	}, double(files.size()));
+
+	return samples;
+}
+
+// --- VIEW SELECTION ---
+
+// Pose signature of a detected board: position, scale, in-plane rotation and the
+// foreshortening of opposite edges (tilt)
+vector<double> poseFeatures(const Mat& corners, Size checkboardSize, Size imageSize) {
+	const Point2f* pts = corners.ptr<Point2f>();
+	int w = checkboardSize.width, h = checkboardSize.height;
+	Point2f p00 = pts[0], p10 = pts[w - 1], p01 = pts[(h - 1) * w], p11 = pts[h * w - 1];
+
+	Point2f center = (p00 + p10 + p01 + p11) * 0.25f;
+	vector<Point2f> quad = { p00, p10, p11, p01 };
+	double scale = sqrt(contourArea(quad) / imageSize.area());
+	double angle = atan2(p10.y - p00.y, p10.x - p00.x);
+	double tiltX = log(max(1e-3, norm(p01 - p00)) / max(1e-3, norm(p11 - p10)));
+	double tiltY = log(max(1e-3, norm(p10 - p00)) / max(1e-3, norm(p11 - p01)));
+
+	return { center.x / imageSize.width, center.y / imageSize.height, scale,
+		0.5 * cos(angle), 0.5 * sin(angle), tiltX, tiltY };
+}
+
+// Greedy choice of the `maxViews` most informative views. Each step takes the view that
+// covers the most still uncovered image area (8x8 grid), is farthest in pose from the
+// views already taken and is sharp. Returns indices into `views`.
+vector<int> selectViews(const vector<const SampleCorners*>& views, Size checkboardSize, Size imageSize, int maxViews) {
+	const int grid = 8;
+	int n = int(views.size());
+
+	vector<vector<double>> features(n);
+	vector<vector<int>> cells(n);
+	double maxSharpness = 1e-9;
+	for (int i = 0; i < n; i++) {
+		features[i] = poseFeatures(views[i]->corners, checkboardSize, imageSize);
+		maxSharpness = max(maxSharpness, views[i]->sharpness);
+
+		vector<bool> hit(grid * grid, false);
+		const Point2f* pts = views[i]->corners.ptr<Point2f>();
+		for (size_t k = 0; k < views[i]->corners.total(); k++) {
+			int gx = min(grid - 1, max(0, int(pts[k].x * grid / imageSize.width)));
+			int gy = min(grid - 1, max(0, int(pts[k].y * grid / imageSize.height)));
+			hit[gy * grid + gx] = true;
+		}
+		for (int c = 0; c < grid * grid; c++) {
+			if (hit[c]) cells[i].push_back(c);
+		}
+	}
+
+	vector<int> selected;
+	vector<bool> taken(n, false), covered(grid * grid, false);
+	while (int(selected.size()) < min(n, maxViews)) {
+		int best = -1;
+		double bestScore = -1;
+
+		for (int i = 0; i < n; i++) {
+			if (taken[i]) continue;
+
+			int gain = 0;
+			for (int c : cells[i]) gain += covered[c] ? 0 : 1;
+
+			double diversity = 1.0;
+			for (int j : selected) diversity = min(diversity, norm(Mat(features[i]), Mat(features[j])));
+
+			double score = double(gain) / (grid * grid) + diversity + 0.5 * views[i]->sharpness / maxSharpness;
+			if (score > bestScore) {
+				bestScore = score;
+				best = i;
+			}
+		}
+
+		taken[best] = true;
+		selected.push_back(best);
+		for (int c : cells[best]) covered[c] = true;
+	}
+
+	sort(selected.begin(), selected.end());
+	return selected;
+}
+
+// RMS reprojection error of views that were not used for calibration: each board's pose
+// is solved on undistorted normalized corners, then reprojected through K, D
+double heldOutError(const vector<const SampleCorners*>& views, const vector<Point3f>& pattern, const Matx33d& K, const Vec4d& D) {
+	double sum = 0;
+	size_t count = 0;
+
+	for (const auto* view : views) {
+		Mat normalized;
+		fisheye::undistortPoints(view->corners, normalized, K, D);
+
+		Vec3d rvec, tvec;
+		if (!cv::solvePnP(pattern, normalized, Matx33d::eye(), noArray(), rvec, tvec)) continue;
+
+		vector<Point2f> projected;
+		fisheye::projectPoints(pattern, projected, rvec, tvec, K, D);
+
+		const Point2f* pts = view->corners.ptr<Point2f>();
+		for (size_t k = 0; k < projected.size(); k++) {
+			Point2f d = projected[k] - pts[k];
+			sum += d.dot(d);
+			count++;
+		}
+	}
+	return count > 0 ? sqrt(sum / count) : -1;
+}
+
+// Fisheye rectification tables for one image size, in OpenCV's compact fixed-point form
+// (CV_16SC2 integer coordinates + CV_16UC1 interpolation weights)
+struct UndistortMaps {
+	Mat map1;
+	Mat map2;
+};
+
+typedef map<pair<int, int>, UndistortMaps> UndistortMapCache;
+
+// Tables are computed once per image size and reused for every image of that size
+const UndistortMaps& getUndistortMaps(UndistortMapCache& cache, const Matx33d& K, const Vec4d& D, Size size) {
+	auto key = make_pair(size.width, size.height);
+	auto it = cache.find(key);
+	if (it != cache.end()) return it->second;
+
+	UndistortMaps& maps = cache[key];
+	// K is used for both original and new camera matrix to keep the scale
+	fisheye::initUndistortRectifyMap(K, D, Matx33d::eye(), K, size, CV_16SC2, maps.map1, maps.map2);
+	return maps;
+}
+
+// Binary calibration bundle: K, D and precomputed undistortion maps, so import runs start
+// without any map computation. Native byte order:
+//   "FEYEBNDL" | uint32 version | 9 x double K | 4 x double D | uint32 count |
+//   count x (int32 width | int32 height | map1 (w*h*4 bytes) | map2 (w*h*2 bytes))
+const char BUNDLE_MAGIC[8] = { 'F', 'E', 'Y', 'E', 'B', 'N', 'D', 'L' };
+const uint32_t BUNDLE_VERSION = 1;
+
+bool isBundle(const string& file) {
+	ifstream in(file, ios::binary);
+	char magic[8];
+	return in.read(magic, sizeof(magic)) && memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool writeBundle(const string& file, const Matx33d& K, const Vec4d& D, const UndistortMapCache& cache) {
+	ofstream out(file, ios::binary);
+	if (!out.is_open()) return false;
+
+	uint32_t count = uint32_t(cache.size());
+	out.write(BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+	out.write((const char*)&BUNDLE_VERSION, sizeof(BUNDLE_VERSION));
+	out.write((const char*)K.val, sizeof(K.val));
+	out.write((const char*)D.val, sizeof(D.val));
+	out.write((const char*)&count, sizeof(count));
+
+	for (const auto& [key, maps] : cache) {
+		int32_t w = key.first, h = key.second;
+		out.write((const char*)&w, sizeof(w));
+		out.write((const char*)&h, sizeof(h));
+		Mat map1 = maps.map1.isContinuous() ? maps.map1 : maps.map1.clone();
+		Mat map2 = maps.map2.isContinuous() ? maps.map2 : maps.map2.clone();
+		out.write((const char*)map1.data, map1.total() * map1.elemSize());
+		out.write((const char*)map2.data, map2.total() * map2.elemSize());
+	}
+	return bool(out);
+}
+
+bool readBundle(const string& file, Matx33d& K, Vec4d& D, UndistortMapCache& cache) {
+	ifstream in(file, ios::binary | ios::ate);
+	char magic[8];
+	uint32_t version = 0, count = 0;
+
+	// Sizes are checked against what is left in the file before allocating, so a corrupt
+	// or truncated bundle is rejected instead of requesting a huge Mat
+	uint64_t fileSize = in ? uint64_t(in.tellg()) : 0;
+	in.seekg(0);
+	auto remaining = [&]() { return fileSize - uint64_t(in.tellg()); };
+
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) != 0) return false;
+	if (!in.read((char*)&version, sizeof(version)) || version != BUNDLE_VERSION) return false;
+	if (!in.read((char*)K.val, sizeof(K.val)) || !in.read((char*)D.val, sizeof(D.val))) return false;
+	if (!in.read((char*)&count, sizeof(count))) return false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		int32_t w = 0, h = 0;
+		if (!in.read((char*)&w, sizeof(w)) || !in.read((char*)&h, sizeof(h)) || w <= 0 || h <= 0) return false;
+		// map1: 2 x int16, map2: uint16 per pixel
+		if (uint64_t(w) * uint64_t(h) * 6 > remaining()) return false;
+
+		UndistortMaps maps;
+		maps.map1.create(h, w, CV_16SC2);
+		maps.map2.create(h, w, CV_16UC1);
+		if (!in.read((char*)maps.map1.data, maps.map1.total() * maps.map1.elemSize())) return false;
+		if (!in.read((char*)maps.map2.data, maps.map2.total() * maps.map2.elemSize())) return false;
+		cache[make_pair(w, h)] = maps;
+	}
+	return true;
+}
+
+// --- BATCH PIPELINE ---
+
+// Fixed capacity FIFO between pipeline stages. push() blocks while the queue is full,
+// pop() blocks while it is empty and returns false once it is closed and drained
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(max<size_t>(1, capacity)) {}
+
+	bool push(T item) {
+		unique_lock<mutex> lock(m);
+		notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+		if (closed) return false;
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	bool pop(T& item) {
+		unique_lock<mutex> lock(m);
+		notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+		if (items.empty()) return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close() {
+		lock_guard<mutex> lock(m);
+		closed = true;
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+private:
+	size_t capacity;
+	deque<T> items;
+	mutex m;
+	condition_variable notEmpty, notFull;
+	bool closed = false;
+};
+
+// Thread split between the stages for at least 3 threads. Decoding and encoding compressed
+// images dominate, remap is mostly memory bound and needs fewer threads
+struct PipelineThreads {
+	int decoders;
+	int remappers;
+	int encoders;
+
+	explicit PipelineThreads(int threads) {
+		decoders = max(1, threads * 3 / 8);
+		encoders = max(1, threads * 3 / 8);
+		remappers = max(1, threads - decoders - encoders);
+	}
+};
+
+// Runs `count` threads of `worker`, then closes `output` once all of them have finished
+template <typename T>
+thread runStage(int count, function<void()> worker, BoundedQueue<T>& output) {
+	return thread([count, worker, &output] {
+		vector<thread> threads;
+		for (int i = 0; i < count; i++) threads.emplace_back(worker);
+		for (auto& t : threads) t.join();
+		output.close();
+	});
+}
+
+struct BatchFrame {
+	path source;
+	Mat image;
+};
+
+struct BatchStats {
+	atomic<int> images{0};
+	atomic<int> failed{0};
+	atomic<uint64_t> bytesIn{0};
+	atomic<uint64_t> bytesOut{0};
+};
+
+// Undistorts `files` into `destDir` through decode -> remap -> encode stages connected
+// by bounded queues, so at most a few images per thread are in memory at any time.
+// With fewer than 3 threads there is one thread per stage at most, so the images are
+// processed one after another on the calling thread instead
+void undistortBatch(const vector<path>& files, const string& destDir, const Matx33d& K, const Vec4d& D, UndistortMapCache& mapCache, int threads, BatchStats& stats) {
+	mutex mapsMutex, logMutex;
+
+	auto decodeFrame = [&](const path& source, vector<uchar>& bytes, BatchFrame& frame) {
+		frame.source = source;
+		frame.image.release();
+		if (readFileBytes(source.string(), bytes)) frame.image = imdecode(bytes, IMREAD_COLOR);
+		if (frame.image.empty()) {
+			lock_guard<mutex> lock(logMutex);
+			cerr << "Failed to read image: " << source.string() << endl;
+			stats.failed++;
+			return false;
+		}
+		stats.bytesIn += bytes.size();
+		return true;
+	};
+
+	auto remapFrame = [&](BatchFrame& frame) {
+		const UndistortMaps* maps;
+		{
+			lock_guard<mutex> lock(mapsMutex);
+			maps = &getUndistortMaps(mapCache, K, D, frame.image.size());
+		}
+		Mat undistorted;
+		remap(frame.image, undistorted, maps->map1, maps->map2, INTER_LINEAR, BORDER_CONSTANT);
+		frame.image = undistorted;
+	};
+
+	auto encodeFrame = [&](const BatchFrame& frame, vector<uchar>& bytes) {
+		string ext = frame.source.extension().string();
+		path outPath = path(destDir) / (frame.source.stem().string() + "_undistored" + ext);
+
+		bool saved = imencode(ext, frame.image, bytes);
+		if (saved) {
+			ofstream out(outPath, ios::binary);
+			saved = bool(out.write((const char*)bytes.data(), bytes.size()));
+		}
+
+		lock_guard<mutex> lock(logMutex);
+		if (saved) {
+			cout << "Saved to " << outPath.string() << endl;
+			stats.images++;
+			stats.bytesOut += bytes.size();
+		} else {
+			cerr << "Failed to save to " << outPath.string() << endl;
+			stats.failed++;
+		}
+	};
+
+	int cvThreads = getNumThreads();
+
+	if (threads < 3) {
+		setNumThreads(max(1, threads));
+		vector<uchar> bytes;
+		BatchFrame frame;
+		for (const auto& file : files) {
+			if (!decodeFrame(file, bytes, frame)) continue;
+			remapFrame(frame);
+			encodeFrame(frame, bytes);
+		}
+		setNumThreads(cvThreads);
+		return;
+	}
+
+	PipelineThreads split(threads);
+	BoundedQueue<BatchFrame> decoded(2 * split.remappers), remapped(2 * split.encoders);
+	atomic<size_t> next{0};
+
+	// The pipeline provides the parallelism, keep OpenCV from nesting its own pool in every stage
+	setNumThreads(1);
+
+	thread decodeStage = runStage(split.decoders, [&] {
+		vector<uchar> bytes;
+		for (size_t i = next++; i < files.size(); i = next++) {
+			BatchFrame frame;
+			if (decodeFrame(files[i], bytes, frame)) decoded.push(std::move(frame));
+		}
+	}, decoded);
+
+	thread remapStage = runStage(split.remappers, [&] {
+		BatchFrame frame;
+		while (decoded.pop(frame)) {
+			remapFrame(frame);
+			remapped.push(std::move(frame));
+		}
+	}, remapped);
+
+	vector<thread> encoders;
+	for (int i = 0; i < split.encoders; i++) {
+		encoders.emplace_back([&] {
+			BatchFrame frame;
+			vector<uchar> bytes;
+			while (remapped.pop(frame)) encodeFrame(frame, bytes);
+		});
+	}
+
+	decodeStage.join();
+	remapStage.join();
+	for (auto& t : encoders) t.join();
+
+	setNumThreads(cvThreads);
+}
+
+// --- VIDEO ---
+
+bool isVideoFile(const path& file) {
+	string ext = file.extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return tolower(c); });
+	return ext == ".mp4" || ext == ".mov" || ext == ".avi" || ext == ".mkv" || ext == ".m4v";
+}
+
+struct VideoFrame {
+	int64_t index;
+	Mat image;
+};
+
+// Undistorts a video with one reader, several remap workers and one writer. Frames are
+// remapped out of order and put back in sequence before encoding. Returns the number of
+// frames written, or -1 if the video could not be opened
+int64_t undistortVideo(const path& source, const string& destDir, const Matx33d& K, const Vec4d& D, UndistortMapCache& mapCache, int threads) {
+	VideoCapture capture(source.string());
+	if (!capture.isOpened()) {
+		cerr << "Failed to open video: " << source.string() << endl;
+		return -1;
+	}
+
+	Size size(int(capture.get(CAP_PROP_FRAME_WIDTH)), int(capture.get(CAP_PROP_FRAME_HEIGHT)));
+	double fps = capture.get(CAP_PROP_FPS);
+	if (fps <= 0) fps = 30;
+
+	path outPath = path(destDir) / (source.stem().string() + "_undistored" + source.extension().string());
+	VideoWriter writer(outPath.string(), int(capture.get(CAP_PROP_FOURCC)), fps, size);
+	if (!writer.isOpened()) {
+		// Source codec not available for encoding, fall back to MPEG-4 part 2
+		writer.open(outPath.string(), VideoWriter::fourcc('m', 'p', '4', 'v'), fps, size);
+	}
+	if (!writer.isOpened()) {
+		cerr << "Failed to open video for writing: " << outPath.string() << endl;
+		return -1;
+	}
+
+	const UndistortMaps& maps = getUndistortMaps(mapCache, K, D, size);
+	int remappers = max(1, threads - 2);
+	BoundedQueue<VideoFrame> decoded(2 * remappers), remapped(2 * remappers);
+
+	// Frames read but not yet written. The reader waits while this many are in flight,
+	// which bounds the reorder buffer even when one remap is slow
+	const int64_t maxInFlight = 4 * remappers;
+	int64_t written = 0;
+	mutex flowMutex;
+	condition_variable flowCond;
+
+	int cvThreads = getNumThreads();
+	setNumThreads(1);
+
+	thread reader([&] {
+		for (int64_t index = 0;; index++) {
+			{
+				unique_lock<mutex> lock(flowMutex);
+				flowCond.wait(lock, [&] { return index - written < maxInFlight; });
+			}
+			VideoFrame frame { index, Mat() };
+			if (!capture.read(frame.image) || frame.image.empty()) break;
+			if (frame.image.size() != size) resize(frame.image, frame.image, size);
+			decoded.push(std::move(frame));
+		}
+		decoded.close();
+	});
+
+	thread remapStage = runStage(remappers, [&] {
+		VideoFrame frame;
+		while (decoded.pop(frame)) {
+			Mat undistorted;
+			remap(frame.image, undistorted, maps.map1, maps.map2, INTER_LINEAR, BORDER_CONSTANT);
+			frame.image = undistorted;
+			remapped.push(std::move(frame));
+		}
+	}, remapped);
+
+	// Reorder buffer: holds fewer than maxInFlight frames
+	map<int64_t, Mat> pending;
+	VideoFrame frame;
+	while (remapped.pop(frame)) {
+		pending[frame.index] = frame.image;
+		for (auto it = pending.find(written); it != pending.end(); it = pending.find(written)) {
+			writer.write(it->second);
+			pending.erase(it);
+
+			lock_guard<mutex> lock(flowMutex);
+			written++;
+			flowCond.notify_one();
+		}
+	}
+
+	reader.join();
+	remapStage.join();
+	setNumThreads(cvThreads);
+
+	cout << "Saved to " << outPath.string() << endl;
+	return written;
+}
+
+// --- BENCHMARK ---
+
+struct BenchOptions {
+	Size resolution;           // Synthetic view size, empty = no benchmark
+	int views = 20;            // Number of rendered boards
+	string outDir;             // Also write the renders here (for the addon benchmark)
+};
+
+// Latency summary of one benchmarked stage
+struct BenchStage {
+	vector<double> ms;
+
+	double percentile(double q) const {
+		vector<double> sorted = ms;
+		sort(sorted.begin(), sorted.end());
+		return sorted[min(sorted.size() - 1, size_t(q * (sorted.size() - 1) + 0.5))];
+	}
+
+	string json(const string& extra = "") const {
+		if (ms.empty()) return "{ \"images\": 0 }";
+		double total = 0;
+		for (double t : ms) total += t;
+		return cv::format("{ \"images\": %d, \"imagesPerSec\": %.3f, \"p50Ms\": %.3f, \"p90Ms\": %.3f, \"p99Ms\": %.3f, \"maxMs\": %.3f%s }",
+			int(ms.size()), ms.size() * 1000.0 / max(1e-9, total), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0), extra.c_str());
+	}
+};
+
+template <typename Fn>
+double timeMs(Fn fn) {
+	auto tik = chrono::high_resolution_clock::now();
+	fn();
+	auto tok = chrono::high_resolution_clock::now();
+	return chrono::duration<double, milli>(tok - tik).count();
+}
+
+// Peak resident set size of this process in KiB, -1 where unsupported
+long peakRssKb() {
+	#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		#ifdef __APPLE__
+		return long(usage.ru_maxrss / 1024);
+		#else
+		return long(usage.ru_maxrss);
+		#endif
+	}
+	#endif
+	return -1;
+}
+
+// Renders `count` views of a checkboard seen through a known fisheye camera. Each board is
+// drawn with a random pose through the pinhole homography K [r1 r2 t], then distorted by
+// sampling the pinhole render at the undistorted position of every fisheye pixel
+vector<Mat> renderBoards(Size checkboardSize, Size resolution, int count, Matx33d& K, Vec4d& D) {
+	const int square = 32;
+	double f = 0.6 * resolution.width;
+	K = Matx33d(f, 0, resolution.width / 2.0, 0, f, resolution.height / 2.0, 0, 0, 1);
+	D = Vec4d(-0.02, 0.005, 0, 0);
+
+	// Inner corners plus one square of border on each side, then a white margin
+	Size squares(checkboardSize.width + 1, checkboardSize.height + 1);
+	Mat texture(Size((squares.width + 2) * square, (squares.height + 2) * square), CV_8UC1, Scalar(255));
+	for (int i = 0; i < squares.height; i++) {
+		for (int j = 0; j < squares.width; j++) {
+			if ((i + j) % 2 == 0) rectangle(texture, Rect((j + 1) * square, (i + 1) * square, square, square), Scalar(0), FILLED);
+		}
+	}
+
+	Mat pixels(resolution, CV_32FC2), undistortMap;
+	for (int y = 0; y < resolution.height; y++) {
+		for (int x = 0; x < resolution.width; x++) pixels.at<Vec2f>(y, x) = Vec2f(float(x), float(y));
+	}
+	fisheye::undistortPoints(pixels.reshape(2, 1), undistortMap, K, D, noArray(), K);
+	undistortMap = undistortMap.reshape(2, resolution.height);
+
+	// Board plane in square units, texture pixel (u, v) at (u / square, v / square, 0)
+	Point3d center(texture.cols / 2.0 / square, texture.rows / 2.0 / square, 0);
+	double distance = f * (squares.width + 2) / (0.5 * resolution.width);
+	Matx33d toSquares(1.0 / square, 0, 0, 0, 1.0 / square, 0, 0, 0, 1);
+
+	RNG rng(0x5eed);
+	vector<Mat> views;
+	for (int v = 0; v < count; v++) {
+		Vec3d rvec(rng.uniform(-0.6, 0.6), rng.uniform(-0.6, 0.6), rng.uniform(-0.35, 0.35));
+		Matx33d R;
+		Rodrigues(rvec, R);
+
+		double z = distance * rng.uniform(0.8, 1.3);
+		Vec3d position(rng.uniform(-0.25, 0.25) * resolution.width * z / f, rng.uniform(-0.25, 0.25) * resolution.height * z / f, z);
+		Vec3d t = position - R * Vec3d(center.x, center.y, center.z);
+
+		Matx33d Rt(R(0, 0), R(0, 1), t[0], R(1, 0), R(1, 1), t[1], R(2, 0), R(2, 1), t[2]);
+		Mat pinhole, view;
+		warpPerspective(texture, pinhole, Mat(K * Rt * toSquares), resolution, INTER_LINEAR, BORDER_CONSTANT, Scalar(128));
+		remap(pinhole, view, undistortMap, noArray(), INTER_LINEAR, BORDER_CONSTANT, Scalar(128));
+		views.push_back(view);
+	}
+	return views;
+}
+
+// Times corner detection, calibration and undistortion on synthetic renders and prints
+// the results as one JSON object
+int runBench(const BenchOptions& bench, const DetectOptions& detect, Size checkboardSize, int threads) {
+	Matx33d trueK, K;
+	Vec4d trueD, D;
+	vector<Mat> views = renderBoards(checkboardSize, bench.resolution, bench.views, trueK, trueD);
+
+	vector<vector<uchar>> encoded(views.size());
+	for (size_t i = 0; i < views.size(); i++) {
+		Mat color;
+		cvtColor(views[i], color, COLOR_GRAY2BGR);
+		imencode(".jpg", color, encoded[i]);
+		if (!bench.outDir.empty()) {
+			create_directories(bench.outDir);
+			imwrite((path(bench.outDir) / cv::format("board_%03d.jpg", int(i))).string(), color);
+		}
+	}
+
+	// Corner detection on decoded gray views
+	BenchStage detectStage;
+	vector<vector<Point3f>> objPoints;
+	vector<Mat> imgPoints;
+	vector<Point3f> pattern = calibratePattern(checkboardSize, 1.0);
+	for (const auto& view : views) {
+		Mat corners;
+		bool found = false;
+		detectStage.ms.push_back(timeMs([&] { found = detectChessboardCoarseToFine(view, checkboardSize, corners, detect.coarseSide); }));
+		if (found) {
+			objPoints.push_back(pattern);
+			imgPoints.push_back(corners);
+		}
+	}
+
+	// Calibration solve over every detected board, and the whole decode -> detect -> solve
+	// path that the bindings' calibrate() covers
+	BenchStage calibrateStage, calibrateEndToEndStage;
+	double error = -1;
+	if (!objPoints.empty()) {
+		int flag = CALIB_RECOMPUTE_EXTRINSIC | CALIB_CHECK_COND | CALIB_FIX_SKEW;
+		TermCriteria criteria(TermCriteria::EPS | TermCriteria::MAX_ITER, 30, 1e-6);
+		try {
+			for (int repeat = 0; repeat < 3; repeat++) {
+				calibrateStage.ms.push_back(timeMs([&] { error = calibrate(objPoints, imgPoints, bench.resolution, K, D, noArray(), noArray(), flag, criteria); }));
+			}
+			for (int repeat = 0; repeat < 3; repeat++) {
+				calibrateEndToEndStage.ms.push_back(timeMs([&] {
+					vector<vector<Point3f>> obj;
+					vector<Mat> img;
+					for (const auto& bytes : encoded) {
+						Mat gray = imdecode(bytes, IMREAD_GRAYSCALE), corners;
+						if (detectChessboardCoarseToFine(gray, checkboardSize, corners, detect.coarseSide)) {
+							obj.push_back(pattern);
+							img.push_back(corners);
+						}
+					}
+					Matx33d k;
+					Vec4d d;
+					if (!obj.empty()) calibrate(obj, img, bench.resolution, k, d, noArray(), noArray(), flag, criteria);
+				}));
+			}
+		} catch (const cv::Exception& e) {
+			cerr << "Calibration failed: " << e.what() << endl;
+			calibrateStage.ms.clear();
+			calibrateEndToEndStage.ms.clear();
+		}
+	}
+	if (calibrateStage.ms.empty()) {
+		K = trueK;
+		D = trueD;
+	}
+
+	// Undistortion: remap only with cached maps, and the full decode -> remap -> encode path.
+	// The remap runs on 4 channel frames, the same as the raw RGBA frames of the bindings
+	BenchStage mapsStage, remapStage, undistortStage;
+	UndistortMapCache mapCache;
+	mapsStage.ms.push_back(timeMs([&] { getUndistortMaps(mapCache, K, D, bench.resolution); }));
+	const UndistortMaps& maps = getUndistortMaps(mapCache, K, D, bench.resolution);
+	for (const auto& bytes : encoded) {
+		Mat color, undistorted;
+		cvtColor(imdecode(bytes, IMREAD_COLOR), color, COLOR_BGR2BGRA);
+		remapStage.ms.push_back(timeMs([&] { remap(color, undistorted, maps.map1, maps.map2, INTER_LINEAR, BORDER_CONSTANT); }));
+
+		vector<uchar> out;
+		undistortStage.ms.push_back(timeMs([&] {
+			Mat distorted = imdecode(bytes, IMREAD_COLOR), result;
+			remap(distorted, result, maps.map1, maps.map2, INTER_LINEAR, BORDER_CONSTANT);
+			imencode(".jpg", result, out);
+		}));
+	}
+
+	// Batch pipeline throughput over the same images, written to a scratch directory and
+	// run through undistortBatch as the CLI does. Its progress goes to stderr to keep
+	// stdout valid JSON
+	path scratch = temp_directory_path() / cv::format("fisheye-bench-%lld", (long long)chrono::steady_clock::now().time_since_epoch().count());
+	path scratchOut = scratch / "undistorted";
+	create_directories(scratchOut);
+	vector<path> batchFiles;
+	for (size_t i = 0; i < encoded.size(); i++) {
+		batchFiles.push_back(scratch / cv::format("board_%03d.jpg", int(i)));
+		ofstream out(batchFiles.back(), ios::binary);
+		out.write((const char*)encoded[i].data(), encoded[i].size());
+	}
+	BatchStats batchStats;
+	ostream results(cout.rdbuf());
+	cout.rdbuf(cerr.rdbuf());
+	double batchMs = timeMs([&] { undistortBatch(batchFiles, scratchOut.string(), K, D, mapCache, threads, batchStats); });
+	cout.rdbuf(results.rdbuf());
+	error_code removeError;
+	remove_all(scratch, removeError);
+
+	cout << "{" << endl;
+	cout << "  \"binding\": \"cpp\"," << endl;
+	cout << "  \"resolution\": [" << bench.resolution.width << ", " << bench.resolution.height << "]," << endl;
+	cout << "  \"board\": [" << checkboardSize.width << ", " << checkboardSize.height << "]," << endl;
+	cout << "  \"threads\": " << threads << "," << endl;
+	cout << "  \"detect\": " << detectStage.json(cv::format(", \"found\": %d", int(objPoints.size()))) << "," << endl;
+	cout << "  \"calibrateEndToEnd\": " << calibrateEndToEndStage.json(cv::format(", \"views\": %d", int(encoded.size()))) << "," << endl;
+	cout << "  \"calibrateSolve\": " << calibrateStage.json(cv::format(", \"views\": %d, \"rmsPx\": %.4f, \"fxError\": %.4f", int(objPoints.size()), error, K(0, 0) - trueK(0, 0))) << "," << endl;
+	cout << "  \"undistortMaps\": " << mapsStage.json() << "," << endl;
+	cout << "  \"remap\": " << remapStage.json() << "," << endl;
+	cout << "  \"undistort\": " << undistortStage.json() << "," << endl;
+	cout << "  \"undistortBatch\": " << cv::format("{ \"images\": %d, \"imagesPerSec\": %.3f }", int(batchStats.images), batchStats.images * 1000.0 / max(1e-9, batchMs)) << "," << endl;
+	cout << "  \"peakRssKb\": " << peakRssKb() << endl;
+	cout << "}" << endl;
+	return 0;
+}
+
+// Whole-string integer option value
+bool parseIntOption(const char* value, int& out) {
+	char rest = 0;
+	return sscanf(value, "%d%c", &out, &rest) == 1;
+}
+
 string promptForInput(const string& message) {
 	cout << message;
 	string input;
@@ -49,6 +943,20 @@ bool usage() {
 	cout << "   Or: ./fisheye <src_dir> <dest_dir> <calibration_file> (Import Mode)" << endl;
 	cout << "   Or: ./fisheye -i (Interactive Mode)" << endl;
 	cout << "   Or: ./fisheye (Default Interactive Mode)" << endl;
+	cout << "<src_dir> may also be a video file (.mp4, .mov, .avi, .mkv, .m4v); videos inside <src_dir> are undistorted as well." << endl;
+	cout << "Options:" << endl;
+	cout << "  --threads <n>         Worker threads for detection and the undistort pipeline (default: all cores)" << endl;
+	cout << "  --coarse <px>         Coarse-to-fine corner detection on a <px> downscaled copy" << endl;
+	cout << "  --validate-corners    Compare detected corners against the full resolution path" << endl;
+	cout << "  --max-views <n>       Calibrate on the <n> most informative views, report error on the rest" << endl;
+	cout << "  --no-cache            Ignore and do not update the samples corner cache" << endl;
+	cout << "  --bundle <file>       Save K, D and the undistortion maps to a binary bundle" << endl;
+	cout << "                        (a bundle can be passed as <calibration_file> in Import Mode)" << endl;
+	cout << "  --bench <w>x<h>       Benchmark detection, calibration and undistortion on synthetic" << endl;
+	cout << "                        <w>x<h> boards and print the results as JSON" << endl;
+	cout << "  --bench-board <w>x<h> Inner corners of the synthetic board (default: 9x6)" << endl;
+	cout << "  --bench-views <n>     Number of synthetic boards (default: 20)" << endl;
+	cout << "  --bench-out <dir>     Also write the synthetic boards to <dir>" << endl;
 	// cout << "   Or: ./fisheye -gui (Window Mode)" << endl;
 
 	cout << "---" << endl;
@@ -67,6 +975,67 @@ int main(int argc, char** argv) {
 	auto tik = chrono::high_resolution_clock::now();
 	auto tok = chrono::high_resolution_clock::now();
 
+	DetectOptions detect;
+	string bundleFile;
+	int threads = getNumberOfCPUs();
+	BenchOptions bench;
+	Size benchBoard(9, 6);
+
+	// Pull --options out first, so the positional modes below only see their arguments
+	vector<char*> positional = { argv[0] };
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			if (!parseIntOption(argv[++i], threads) || threads < 1) {
+				cerr << "Invalid --threads: " << argv[i] << endl;
+				return 1;
+			}
+			setNumThreads(threads);
+		} else if (arg == "--coarse" && i + 1 < argc) {
+			if (!parseIntOption(argv[++i], detect.coarseSide) || detect.coarseSide < 0) {
+				cerr << "Invalid --coarse: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (arg == "--bundle" && i + 1 < argc) {
+			bundleFile = argv[++i];
+		} else if (arg == "--max-views" && i + 1 < argc) {
+			if (!parseIntOption(argv[++i], detect.maxViews) || detect.maxViews < 0) {
+				cerr << "Invalid --max-views: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (arg == "--bench" && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &bench.resolution.width, &bench.resolution.height) != 2 || bench.resolution.width <= 0 || bench.resolution.height <= 0) {
+				cerr << "Invalid --bench: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (arg == "--bench-board" && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &benchBoard.width, &benchBoard.height) != 2 || benchBoard.width < 2 || benchBoard.height < 2) {
+				cerr << "Invalid --bench-board: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (arg == "--bench-views" && i + 1 < argc) {
+			if (sscanf(argv[++i], "%d", &bench.views) != 1 || bench.views < 1) {
+				cerr << "Invalid --bench-views: " << argv[i] << endl;
+				return 1;
+			}
+		} else if (arg == "--bench-out" && i + 1 < argc) {
+			bench.outDir = argv[++i];
+		} else if (arg == "--no-cache") {
+			detect.useCache = false;
+		} else if (arg == "--validate-corners") {
+			detect.validate = true;
+		} else {
+			positional.push_back(argv[i]);
+		}
+	}
+	argc = int(positional.size());
+	positional.push_back(nullptr);
+	argv = positional.data();
+
+	if (bench.resolution.area() > 0) {
+		return runBench(bench, detect, benchBoard, threads);
+	}
+
 	// Check for GUI flag
 	if (argc > 1 && string(argv[1]) == "-gui") {
 		useGui = true;
@@ -147,10 +1116,11 @@ int main(int argc, char** argv) {
 
 	Matx33d K;
 	Vec4d D;
+	UndistortMapCache undistortMaps;
 
 	if (calibrationNeeded) {
-		// 1. Load Calibration Images
-		vector<Mat> images;
+		// 1. Collect Calibration Images
+		vector<string> files;
 		cout << "Loading samples from " << samplesDir << "..." << endl;
 
 		if (!exists(samplesDir)) {
@@ -167,52 +1137,92 @@ int main(int argc, char** argv) {
 
 			// Simple check for jpg/png
 			if (ext == ".jpg" || ext == ".png" || ext == ".jpeg" || ext == ".bmp") {
-				Mat img = imread(p, IMREAD_GRAYSCALE);
-				if (!img.empty()) {
-					images.push_back(img);
-				}
+				files.push_back(p);
 			}
 		}
+		sort(files.begin(), files.end());
 
-		if (images.empty()) {
-			cerr << "No images found in " << samplesDir << endl;
-			if (useGui) system("pause"); // Keep window open to see error
-			return 1;
+		// 2. Detect corners (streamed: images are decoded and released by the workers)
+		Size checkboardSize(checkboardWidth, checkboardHeight);
+		string cacheFile = (path(samplesDir) / CORNER_CACHE_FILE).string();
+		CornerCache cornerCache;
+		if (detect.useCache) loadCornerCache(cacheFile, cornerCache);
+
+		tik = chrono::high_resolution_clock::now();
+		vector<SampleCorners> samples = detectSamples(files, checkboardSize, detect, cornerCache);
+		tok = chrono::high_resolution_clock::now();
+
+		if (detect.useCache) {
+			int reused = int(count_if(samples.begin(), samples.end(), [](const SampleCorners& s) { return s.cached; }));
+			cout << "Corner cache: reused " << reused << " of " << samples.size() << " samples." << endl;
+			if (!saveCornerCache(cacheFile, samples, checkboardSize, detect)) {
+				cerr << "Warning: Could not write corner cache " << cacheFile << endl;
+			}
 		}
-		cout << "Loaded " << images.size() << " images." << endl;
 
-		// 2. Calibrate
-		cout << "Calibrating..." << endl;
-		Size checkboardSize(checkboardWidth, checkboardHeight);
 		vector<vector<Point3f>> objPoints;
 		vector<Mat> imgPoints;
 		vector<Point3f> pattern = calibratePattern(checkboardSize, 1.0);
-		TermCriteria subpixCriteria(TermCriteria::EPS | TermCriteria::MAX_ITER, 30, 0.1);
+		vector<const SampleCorners*> views, heldOut;
+		Size size;
+		int loaded = 0, validated = 0;
+		double diffMean = 0, diffMax = 0;
 
-		for (auto& img : images) {
-			Mat corners;
-			// Use CALIB_CB_ADAPTIVE_THRESH for better robustness
-			tik = chrono::high_resolution_clock::now();
-			bool found = findChessboardCorners(img, checkboardSize, corners,
-				CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE);
+		for (const auto& sample : samples) {
+			if (!sample.loaded) continue;
+			if (loaded++ == 0) size = sample.size;
 
-			if (found) {
-				objPoints.push_back(pattern);
-				cornerSubPix(img, corners, Size(3, 3), Size(-1, -1), subpixCriteria);
-				imgPoints.push_back(corners);
+			cout << "findChessboardCorners: " << (sample.cached ? "cached" : to_string(sample.ms)) << (sample.found ? "" : " (not found)") << endl;
+			if (sample.found) {
+				views.push_back(&sample);
 			}
 
-			tok = chrono::high_resolution_clock::now();
-			cout << "findChessboardCorners: " << chrono::duration_cast<chrono::milliseconds>(tok - tik).count() << endl;
+			if (sample.validated) {
+				cout << "  corners vs full resolution: mean " << sample.diffMean << " px, max " << sample.diffMax << " px" << endl;
+				validated++;
+				diffMean += sample.diffMean;
+				diffMax = max(diffMax, sample.diffMax);
+			}
 		}
 
+		if (validated > 0) {
+			cout << "Corner validation over " << validated << " samples: mean " << diffMean / validated << " px, max " << diffMax << " px" << endl;
+		}
+
+		if (loaded == 0) {
+			cerr << "No images found in " << samplesDir << endl;
+			if (useGui) system("pause"); // Keep window open to see error
+			return 1;
+		}
+		cout << "Loaded " << loaded << " images. Detection time: " << chrono::duration_cast<chrono::milliseconds>(tok - tik).count() << endl;
+
+		// 3. Calibrate
+		vector<int> selected;
+		if (detect.maxViews > 0 && int(views.size()) > detect.maxViews) {
+			selected = selectViews(views, checkboardSize, size, detect.maxViews);
+			cout << "Selected " << selected.size() << " of " << views.size() << " views." << endl;
+		} else {
+			for (int i = 0; i < int(views.size()); i++) selected.push_back(i);
+		}
+
+		for (int i = 0, next = 0; i < int(views.size()); i++) {
+			if (next < int(selected.size()) && selected[next] == i) {
+				objPoints.push_back(pattern);
+				imgPoints.push_back(views[i]->corners);
+				next++;
+			} else {
+				heldOut.push_back(views[i]);
+			}
+		}
+
+		cout << "Calibrating..." << endl;
+
 		if (objPoints.empty()) {
 			cerr << "Could not detect any checkboards with size " << checkboardWidth << "x" << checkboardHeight << endl;
 			if (useGui) system("pause");
 			return 1;
 		}
 
-		Size size = images[0].size();
 		int flag = CALIB_RECOMPUTE_EXTRINSIC | CALIB_CHECK_COND | CALIB_FIX_SKEW;
 		TermCriteria criteria(TermCriteria::EPS | TermCriteria::MAX_ITER, 30, 1e-6);
 
@@ -222,6 +1232,10 @@ int main(int argc, char** argv) {
 
 		cout << "Calibration done. Reprojection error: " << error << ". Time: " << chrono::duration_cast<chrono::milliseconds>(tok - tik).count() << endl;
 
+		if (!heldOut.empty()) {
+			cout << "Held-out reprojection error: " << heldOutError(heldOut, pattern, K, D) << " (" << heldOut.size() << " views)" << endl;
+		}
+
 		if (exportCalibration) {
 			cout << "Exporting calibration data to " << configFile << "..." << endl;
 			ofstream out(configFile);
@@ -235,6 +1249,13 @@ int main(int argc, char** argv) {
 			}
 		}
 
+	} else if (importCalibration && isBundle(configFile)) {
+		cout << "Importing calibration bundle from " << configFile << "..." << endl;
+		if (!readBundle(configFile, K, D, undistortMaps)) {
+			cerr << "Error: Invalid calibration bundle: " << configFile << endl;
+			return 1;
+		}
+		cout << "Import successful (" << undistortMaps.size() << " precomputed maps)." << endl;
 	} else if (importCalibration) {
 		cout << "Importing calibration data from " << configFile << "..." << endl;
 		ifstream in(configFile);
@@ -259,11 +1280,12 @@ int main(int argc, char** argv) {
 		}
 	}
 
-	// 3. Undistort & 4. Save
-	cout << "Undistorting images from " << srcPath << " to " << destPath << "..." << endl;
+	// 4. Undistort & 5. Save
+	cout << "Undistorting from " << srcPath << " to " << destPath << "..." << endl;
 
-	if (!exists(srcPath) || !is_directory(srcPath)) {
-		cerr << "Error: Source path '" << srcPath << "' is not a directory." << endl;
+	bool videoSource = is_regular_file(srcPath) && isVideoFile(srcPath);
+	if (!exists(srcPath) || !(is_directory(srcPath) || videoSource)) {
+		cerr << "Error: Source path '" << srcPath << "' is not a directory or video file." << endl;
 		if (useGui) system("pause");
 		return 1;
 	}
@@ -280,45 +1302,57 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 
-	int count = 0;
-	for (const auto& entry : directory_iterator(srcPath)) {
-		string p = entry.path().string();
-		if (!entry.is_regular_file()) continue;
-
-		string ext = entry.path().extension().string();
-		string filename = entry.path().stem().string();
+	vector<path> files, videos;
+	if (videoSource) {
+		videos.push_back(srcPath);
+	} else {
+		for (const auto& entry : directory_iterator(srcPath)) {
+			if (!entry.is_regular_file()) continue;
 
-		string ext_lower = ext;
-		transform(ext_lower.begin(), ext_lower.end(), ext_lower.begin(),
-					   [](unsigned char c){ return tolower(c); });
+			string ext_lower = entry.path().extension().string();
+			transform(ext_lower.begin(), ext_lower.end(), ext_lower.begin(),
+						   [](unsigned char c){ return tolower(c); });
 
-		if (ext_lower == ".jpg" || ext_lower == ".png" || ext_lower == ".jpeg" || ext_lower == ".bmp") {
-			Mat distorted = imread(p);
-			if (distorted.empty()) {
-				cerr << "Failed to read image: " << p << endl;
-				continue;
+			if (ext_lower == ".jpg" || ext_lower == ".png" || ext_lower == ".jpeg" || ext_lower == ".bmp") {
+				files.push_back(entry.path());
+			} else if (isVideoFile(entry.path())) {
+				videos.push_back(entry.path());
 			}
+		}
+	}
+	sort(files.begin(), files.end());
+	sort(videos.begin(), videos.end());
 
-			Mat undistorted;
-			// K is used for both original and new camera matrix to keep the scale
-			tik = chrono::high_resolution_clock::now();
-			undistortImage(distorted, undistorted, K, D, K, distorted.size());
-			tok = chrono::high_resolution_clock::now();
+	BatchStats stats;
+	tik = chrono::high_resolution_clock::now();
+	undistortBatch(files, destPath, K, D, undistortMaps, threads, stats);
+	tok = chrono::high_resolution_clock::now();
 
-			cout << "Time: " << chrono::duration_cast<chrono::milliseconds>(tok - tik).count() << endl;
+	double seconds = max(1e-6, chrono::duration<double>(tok - tik).count());
+	cout << "Processed " << stats.images.load() << " images (" << stats.failed.load() << " failed) in " << seconds << " s: "
+		<< stats.images.load() / seconds << " images/s, "
+		<< stats.bytesIn.load() / seconds / (1024 * 1024) << " MB/s read, "
+		<< stats.bytesOut.load() / seconds / (1024 * 1024) << " MB/s written." << endl;
 
-			string outFilename = filename + "_undistored" + ext;
-			path outPath = path(destPath) / outFilename;
+	for (const auto& video : videos) {
+		cout << "Undistorting video " << video.string() << "..." << endl;
+		tik = chrono::high_resolution_clock::now();
+		int64_t frames = undistortVideo(video, destPath, K, D, undistortMaps, threads);
+		tok = chrono::high_resolution_clock::now();
 
-			if (imwrite(outPath.string(), undistorted)) {
-				cout << "Saved to " << outPath.string() << endl;
-				count++;
-			} else {
-				cerr << "Failed to save to " << outPath.string() << endl;
-			}
+		if (frames < 0) continue;
+		seconds = max(1e-6, chrono::duration<double>(tok - tik).count());
+		cout << "Processed " << frames << " frames in " << seconds << " s: " << frames / seconds << " fps." << endl;
+	}
+
+	if (!bundleFile.empty()) {
+		cout << "Saving calibration bundle to " << bundleFile << "..." << endl;
+		if (writeBundle(bundleFile, K, D, undistortMaps)) {
+			cout << "Bundle saved (" << undistortMaps.size() << " maps)." << endl;
+		} else {
+			cerr << "Error: Could not write bundle: " << bundleFile << endl;
 		}
 	}
-	cout << "Processed " << count << " images." << endl;
 
 	if (useGui) system("pause");
 	return 0;
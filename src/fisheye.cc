@@ -4,15 +4,28 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 
-cv::Mat toImageMat(Napi::Buffer<uchar> jsRawImg, int flag = cv::IMREAD_COLOR)
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "chessboard.h"
+
+// Decodes straight from the caller's memory: the Mat is only a header over `buf`
+cv::Mat decodeImage(const uchar *buf, size_t size, int flag = cv::IMREAD_COLOR)
 {
-    uchar *buf = jsRawImg.Data();
-    size_t size = jsRawImg.Length();
-    std::vector<uchar> imgBytes(buf, buf + size);
+    cv::Mat imgBytes(1, int(size), CV_8UC1, const_cast<uchar*>(buf));
     cv::Mat img = cv::imdecode(imgBytes, flag);
     return img;
 }
 
+cv::Mat toImageMat(Napi::Buffer<uchar> jsRawImg, int flag = cv::IMREAD_COLOR)
+{
+    return decodeImage(jsRawImg.Data(), jsRawImg.Length(), flag);
+}
+
 cv::Matx33d getK(Napi::Array jsArray)
 {
     cv::Mat mat(3, 3, CV_64F);
@@ -40,64 +53,139 @@ cv::Vec4d getD(Napi::Array jsArray)
     return mat;
 }
 
-Napi::Buffer<char> encodeMat(Napi::Env env, cv::Mat img, Napi::Object jsExtra) {
-    cv::String ext;
-    std::vector<int> params = std::vector<int>();
+// Encoder settings read from the JS options up front, so encoding can run off the main thread
+struct EncodeOptions
+{
+    cv::String ext = ".jpg";
+    bool hasQuantity = false;
+    int quantity = 0;
+};
+
+// Starts from `options` and overrides only the keys present in jsExtra
+EncodeOptions getEncodeOptions(Napi::Object jsExtra, EncodeOptions options = EncodeOptions()) {
     if (jsExtra.Has("extname")) {
-        ext = cv::String(jsExtra.Get("extname").As<Napi::String>().Utf8Value());
-    } else {
-        ext = cv::String(".jpg");
+        options.ext = cv::String(jsExtra.Get("extname").As<Napi::String>().Utf8Value());
     }
     if (jsExtra.Has("quantity")) {
-        int quantity = int(jsExtra.Get("quantity").As<Napi::Number>().Int32Value());
+        options.hasQuantity = true;
+        options.quantity = int(jsExtra.Get("quantity").As<Napi::Number>().Int32Value());
+    }
+    return options;
+}
+
+std::vector<uchar> encodeImage(const cv::Mat &img, const EncodeOptions &options)
+{
+    const cv::String &ext = options.ext;
+    std::vector<int> params = std::vector<int>();
+    if (options.hasQuantity) {
         if (ext == ".jpg" || ext == ".jpeg") {
             params.push_back(cv::IMWRITE_JPEG_QUALITY);
-            params.push_back(quantity);
+            params.push_back(options.quantity);
         } else if (ext == ".png") {
             params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-            params.push_back(quantity);
+            params.push_back(options.quantity);
         } else if (ext == "webp") {
             params.push_back(cv::IMWRITE_WEBP_QUALITY);
-            params.push_back(quantity);
+            params.push_back(options.quantity);
         }
     }
+
     std::vector<uchar> buf;
     cv::imencode(ext, img, buf, params);
-
-    Napi::Buffer<char> ret = Napi::Buffer<char>::Copy(env, reinterpret_cast<char*>(buf.data()), buf.size());
-    return ret;
+    return buf;
 }
 
-Napi::Buffer<char> Undistort(const Napi::CallbackInfo &info)
+// Hands the encoded bytes to JS without copying: the Buffer owns the vector and frees it
+// in its finalizer. Runtimes that forbid external buffers get a copy instead
+Napi::Buffer<char> toBuffer(Napi::Env env, std::vector<uchar> &&buf)
 {
-    Napi::Env env = info.Env();
+    std::vector<uchar> *owned = new std::vector<uchar>(std::move(buf));
+    return Napi::Buffer<char>::NewOrCopy(env, reinterpret_cast<char*>(owned->data()), owned->size(),
+                                         [](Napi::Env, char*, std::vector<uchar> *hint) { delete hint; }, owned);
+}
 
-    Napi::Buffer<uchar> jsRawImg = info[0].As<Napi::Buffer<uchar>>();
-    Napi::Array jsK = info[1].As<Napi::Array>();
-    Napi::Array jsD = info[2].As<Napi::Array>();
-    
-    Napi::Object jsExtra;
+Napi::Buffer<char> encodeMat(Napi::Env env, cv::Mat img, Napi::Object jsExtra) {
+    return toBuffer(env, encodeImage(img, getEncodeOptions(jsExtra)));
+}
 
-    if (info.Length() == 4) {
-        jsExtra = info[3].As<Napi::Object>();
-    } else {
-        jsExtra = Napi::Object::New(env);
+Napi::Object getExtra(const Napi::CallbackInfo &info, size_t index)
+{
+    if (info.Length() > index && info[index].IsObject()) {
+        return info[index].As<Napi::Object>();
     }
+    return Napi::Object::New(info.Env());
+}
 
-    cv::Mat distorted = toImageMat(jsRawImg);
-    cv::Matx33d k = getK(jsK);
-    cv::Vec4d d = getD(jsD);
-    cv::Mat undistorted;
-
-    cv::Size size = distorted.size();
+float getScale(Napi::Object jsExtra)
+{
     float scale = 1.0;
     if (jsExtra.Has("scale")) {
         scale = jsExtra.Get("scale").As<Napi::Number>().FloatValue();
     }
+    return scale;
+}
+
+cv::Mat undistortMat(const cv::Mat &distorted, const cv::Matx33d &k, const cv::Vec4d &d, float scale)
+{
+    cv::Mat undistorted;
+
+    cv::Size size = distorted.size();
     size.width *= scale;
     size.height *= scale;
 
     cv::fisheye::undistortImage(distorted, undistorted, k, d, k, size);
+    return undistorted;
+}
+
+// Precomputed remap tables for one calibration and input size. They are never modified
+// after creation, so any number of threads can remap with them at once
+struct UndistortMaps
+{
+    cv::Size inputSize;
+    cv::Mat map1;
+    cv::Mat map2;
+};
+
+std::shared_ptr<const UndistortMaps> createUndistortMaps(const cv::Matx33d &k, const cv::Vec4d &d, cv::Size inputSize, float scale)
+{
+    std::shared_ptr<UndistortMaps> maps = std::make_shared<UndistortMaps>();
+    maps->inputSize = inputSize;
+
+    cv::Size size = inputSize;
+    size.width *= scale;
+    size.height *= scale;
+
+    // Same tables fisheye::undistortImage builds internally on every call
+    cv::fisheye::initUndistortRectifyMap(k, d, cv::Matx33d::eye(), k, size, CV_16SC2, maps->map1, maps->map2);
+    return maps;
+}
+
+cv::Mat remapMat(const cv::Mat &distorted, const UndistortMaps &maps)
+{
+    cv::Mat undistorted;
+    cv::remap(distorted, undistorted, maps.map1, maps.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    return undistorted;
+}
+
+std::string sizeMismatch(cv::Size actual, cv::Size expected)
+{
+    return cv::format("Image size %dx%d does not match the undistorter size %dx%d",
+                      actual.width, actual.height, expected.width, expected.height);
+}
+
+Napi::Buffer<char> Undistort(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Buffer<uchar> jsRawImg = info[0].As<Napi::Buffer<uchar>>();
+    Napi::Array jsK = info[1].As<Napi::Array>();
+    Napi::Array jsD = info[2].As<Napi::Array>();
+    Napi::Object jsExtra = getExtra(info, 3);
+
+    cv::Mat distorted = toImageMat(jsRawImg);
+    cv::Matx33d k = getK(jsK);
+    cv::Vec4d d = getD(jsD);
+    cv::Mat undistorted = undistortMat(distorted, k, d, getScale(jsExtra));
 
     return encodeMat(env, undistorted, jsExtra);
 }
@@ -151,45 +239,46 @@ std::vector<cv::Point3f> calibratePattern(cv::Size checkboardSize, float squareS
     return ret;
 }
 
-Napi::Object Calibrate(const Napi::CallbackInfo &info)
+int getCoarseSize(Napi::Object jsExtra)
 {
-    Napi::Env env = info.Env();
-
-    Napi::Array jsImagesArray = info[0].As<Napi::Array>();
-    Napi::Number jsCheckboardWidth = info[1].As<Napi::Number>();
-    Napi::Number jsCheckboardHeight = info[2].As<Napi::Number>();
-
-    cv::Size checkboardSize(jsCheckboardWidth.Int32Value(), jsCheckboardHeight.Int32Value());
+    int coarseSize = 0;
+    if (jsExtra.Has("coarseSize")) {
+        coarseSize = jsExtra.Get("coarseSize").As<Napi::Number>().Int32Value();
+    }
+    return coarseSize;
+}
 
-    std::vector<cv::Mat> images = getImages(jsImagesArray);
+// Returns the number of boards found and used for the solve
+size_t calibrateImages(const std::vector<cv::Mat> &images, cv::Size checkboardSize, int coarseSize, cv::Matx33d &theK, cv::Vec4d &theD)
+{
     std::vector<std::vector<cv::Point3f> > objPoints;
     std::vector<cv::Mat> imgPoints;
 
-    cv::Matx33d theK;
-    cv::Vec4d theD;
-
-    cv::Size imgSize;
-
     std::vector<cv::Point3f> pattern = calibratePattern(checkboardSize, 1.0);
-    cv::TermCriteria subpixCriteria(cv::TermCriteria::EPS | cv::TermCriteria::MAX_ITER, 30, 0.1);
     for (auto const &img : images)
     {
         cv::Mat corners;
-        bool found = cv::findChessboardCorners(img, checkboardSize, corners);
+        bool found = detectChessboardCoarseToFine(img, checkboardSize, corners, coarseSize);
  
         if (found)
         {
             objPoints.push_back(pattern);
-            cv::cornerSubPix(img, corners, cv::Size(3, 3), cv::Size(-1, -1), subpixCriteria);
             imgPoints.push_back(corners);
         }
     }
 
+    if (objPoints.empty()) return 0;
+
     cv::Size size = images.at(0).size();
     int flag = cv::fisheye::CALIB_RECOMPUTE_EXTRINSIC | cv::fisheye::CALIB_CHECK_COND | cv::fisheye::CALIB_FIX_SKEW;
     cv::TermCriteria criteria(cv::TermCriteria::EPS | cv::TermCriteria::MAX_ITER, 30, 1e-6);
     cv::fisheye::calibrate(objPoints, imgPoints, size, theK, theD, cv::noArray(), cv::noArray(), flag, criteria);
 
+    return objPoints.size();
+}
+
+Napi::Object convertKD(Napi::Env env, cv::Matx33d theK, cv::Vec4d theD)
+{
     Napi::Array jsKArray = convertK(env, theK);
     Napi::Array jsDArray = convertD(env, theD);
 
@@ -200,10 +289,554 @@ Napi::Object Calibrate(const Napi::CallbackInfo &info)
     return ret;
 }
 
+Napi::Object Calibrate(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Array jsImagesArray = info[0].As<Napi::Array>();
+    Napi::Number jsCheckboardWidth = info[1].As<Napi::Number>();
+    Napi::Number jsCheckboardHeight = info[2].As<Napi::Number>();
+
+    cv::Size checkboardSize(jsCheckboardWidth.Int32Value(), jsCheckboardHeight.Int32Value());
+    int coarseSize = getCoarseSize(getExtra(info, 3));
+
+    std::vector<cv::Mat> images = getImages(jsImagesArray);
+
+    cv::Matx33d theK;
+    cv::Vec4d theD;
+    if (calibrateImages(images, checkboardSize, coarseSize, theK, theD) == 0)
+    {
+        Napi::Error::New(env, "Could not detect any checkboard").ThrowAsJavaScriptException();
+        return Napi::Object::New(env);
+    }
+
+    return convertKD(env, theK, theD);
+}
+
+// --- Raw pixels: decoded frames in and out, no codec work ---
+
+// Wraps caller-owned pixels described by { width, height, channels, stride } without copying
+bool toRawMat(Napi::Env env, Napi::Buffer<uchar> jsPixels, Napi::Object jsImage, cv::Mat &img)
+{
+    int width = jsImage.Get("width").As<Napi::Number>().Int32Value();
+    int height = jsImage.Get("height").As<Napi::Number>().Int32Value();
+    int channels = jsImage.Has("channels") ? jsImage.Get("channels").As<Napi::Number>().Int32Value() : 4;
+    size_t rowBytes = size_t(width) * channels;
+    size_t stride = jsImage.Has("stride") ? size_t(jsImage.Get("stride").As<Napi::Number>().Int64Value()) : rowBytes;
+
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4 || stride < rowBytes)
+    {
+        Napi::RangeError::New(env, "Invalid raw image layout").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (jsPixels.Length() < stride * (height - 1) + rowBytes)
+    {
+        Napi::RangeError::New(env, "Pixel buffer is smaller than the image layout").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    img = cv::Mat(height, width, CV_8UC(channels), jsPixels.Data(), stride);
+    return true;
+}
+
+// Remaps into extra.output (rows extra.outputStride bytes apart) when given, otherwise into
+// a new Buffer. Returns { data, width, height, channels, stride }
+Napi::Value remapRaw(Napi::Env env, const cv::Mat &distorted, const UndistortMaps &maps, Napi::Object jsExtra)
+{
+    cv::Size size = maps.map1.size();
+    int channels = distorted.channels();
+    size_t rowBytes = size_t(size.width) * channels;
+    size_t stride = jsExtra.Has("outputStride") ? size_t(jsExtra.Get("outputStride").As<Napi::Number>().Int64Value()) : rowBytes;
+    if (stride < rowBytes)
+    {
+        Napi::RangeError::New(env, "Output stride is smaller than a row").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Buffer<uchar> jsOutput;
+    if (jsExtra.Has("output"))
+    {
+        jsOutput = jsExtra.Get("output").As<Napi::Buffer<uchar>>();
+        if (jsOutput.Length() < stride * (size.height - 1) + rowBytes)
+        {
+            Napi::RangeError::New(env, "Output buffer is smaller than the undistorted image").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    else
+    {
+        jsOutput = Napi::Buffer<uchar>::New(env, stride * size.height);
+    }
+
+    // remap writes through the header straight into the JS memory
+    cv::Mat undistorted(size, distorted.type(), jsOutput.Data(), stride);
+    cv::remap(distorted, undistorted, maps.map1, maps.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+
+    Napi::Object ret = Napi::Object::New(env);
+    ret.Set("data", jsOutput);
+    ret.Set("width", Napi::Number::New(env, size.width));
+    ret.Set("height", Napi::Number::New(env, size.height));
+    ret.Set("channels", Napi::Number::New(env, channels));
+    ret.Set("stride", Napi::Number::New(env, double(stride)));
+    return ret;
+}
+
+Napi::Value UndistortRaw(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    cv::Mat distorted;
+    if (!toRawMat(env, info[0].As<Napi::Buffer<uchar>>(), info[1].As<Napi::Object>(), distorted)) return env.Null();
+
+    Napi::Object jsExtra = getExtra(info, 4);
+    std::shared_ptr<const UndistortMaps> maps = createUndistortMaps(getK(info[2].As<Napi::Array>()), getD(info[3].As<Napi::Array>()),
+                                                                    distorted.size(), getScale(jsExtra));
+    return remapRaw(env, distorted, *maps, jsExtra);
+}
+
+// --- Async API: the same work on the libuv thread pool, settled through a Promise ---
+
+// Input buffers stay referenced until the worker is destroyed, so Execute can read their
+// memory off the main thread
+class UndistortWorker : public Napi::AsyncWorker
+{
+public:
+    UndistortWorker(Napi::Env env, Napi::Buffer<uchar> jsRawImg, cv::Matx33d k, cv::Vec4d d, float scale, EncodeOptions options)
+        : Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)),
+          jsRawImgRef(Napi::Persistent(jsRawImg)), data(jsRawImg.Data()), length(jsRawImg.Length()),
+          k(k), d(d), scale(scale), options(options)
+    {
+    }
+
+    // Remaps with shared precomputed tables instead of building them per call
+    UndistortWorker(Napi::Env env, Napi::Buffer<uchar> jsRawImg, std::shared_ptr<const UndistortMaps> maps, EncodeOptions options)
+        : Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)),
+          jsRawImgRef(Napi::Persistent(jsRawImg)), data(jsRawImg.Data()), length(jsRawImg.Length()),
+          scale(1.0), options(options), maps(maps)
+    {
+    }
+
+    Napi::Promise Promise() { return deferred.Promise(); }
+
+    void Execute() override
+    {
+        try
+        {
+            cv::Mat distorted = decodeImage(data, length);
+            if (distorted.empty())
+            {
+                SetError("Could not decode image");
+                return;
+            }
+            if (maps && distorted.size() != maps->inputSize)
+            {
+                SetError(sizeMismatch(distorted.size(), maps->inputSize));
+                return;
+            }
+            cv::Mat undistorted = maps ? remapMat(distorted, *maps) : undistortMat(distorted, k, d, scale);
+            encoded = encodeImage(undistorted, options);
+        }
+        catch (const cv::Exception &e)
+        {
+            SetError(e.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(toBuffer(Env(), std::move(encoded)));
+    }
+
+    void OnError(const Napi::Error &e) override
+    {
+        deferred.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred;
+    Napi::Reference<Napi::Buffer<uchar>> jsRawImgRef;
+    const uchar *data;
+    size_t length;
+    cv::Matx33d k;
+    cv::Vec4d d;
+    float scale;
+    EncodeOptions options;
+    std::shared_ptr<const UndistortMaps> maps;
+    std::vector<uchar> encoded;
+};
+
+Napi::Value UndistortAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Buffer<uchar> jsRawImg = info[0].As<Napi::Buffer<uchar>>();
+    Napi::Object jsExtra = getExtra(info, 3);
+
+    UndistortWorker *worker = new UndistortWorker(env, jsRawImg, getK(info[1].As<Napi::Array>()), getD(info[2].As<Napi::Array>()),
+                                                  getScale(jsExtra), getEncodeOptions(jsExtra));
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+class CalibrateWorker : public Napi::AsyncWorker
+{
+public:
+    CalibrateWorker(Napi::Env env, Napi::Array jsImagesArray, cv::Size checkboardSize, int coarseSize)
+        : Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)),
+          checkboardSize(checkboardSize), coarseSize(coarseSize)
+    {
+        // Each buffer is referenced on its own: the caller may change the array while we run
+        for (uint32_t i = 0; i < jsImagesArray.Length(); i++)
+        {
+            Napi::Buffer<uchar> img = jsImagesArray.Get(i).As<Napi::Buffer<uchar>>();
+            buffers.push_back(std::make_pair(img.Data(), img.Length()));
+            bufferRefs.push_back(Napi::Persistent(img));
+        }
+    }
+
+    Napi::Promise Promise() { return deferred.Promise(); }
+
+    void Execute() override
+    {
+        try
+        {
+            std::vector<cv::Mat> images;
+            for (auto const &buf : buffers)
+            {
+                images.push_back(decodeImage(buf.first, buf.second, cv::IMREAD_GRAYSCALE));
+            }
+            if (images.empty() || images.at(0).empty())
+            {
+                SetError("Could not decode calibration images");
+                return;
+            }
+            if (calibrateImages(images, checkboardSize, coarseSize, theK, theD) == 0)
+            {
+                SetError("Could not detect any checkboard");
+            }
+        }
+        catch (const cv::Exception &e)
+        {
+            SetError(e.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(convertKD(Env(), theK, theD));
+    }
+
+    void OnError(const Napi::Error &e) override
+    {
+        deferred.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred;
+    std::vector<Napi::Reference<Napi::Buffer<uchar>>> bufferRefs;
+    std::vector<std::pair<const uchar*, size_t>> buffers;
+    cv::Size checkboardSize;
+    int coarseSize;
+    cv::Matx33d theK;
+    cv::Vec4d theD;
+};
+
+Napi::Value CalibrateAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Array jsImagesArray = info[0].As<Napi::Array>();
+    cv::Size checkboardSize(info[1].As<Napi::Number>().Int32Value(), info[2].As<Napi::Number>().Int32Value());
+
+    CalibrateWorker *worker = new CalibrateWorker(env, jsImagesArray, checkboardSize, getCoarseSize(getExtra(info, 3)));
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// --- Batch API: many images on a native thread pool, one set of tables per image size ---
+
+struct BatchResult
+{
+    uint32_t index;
+    std::shared_ptr<std::vector<uchar>> encoded;
+    std::string error;
+};
+
+// Execute runs `concurrency` native threads that pull images off a shared counter. Results
+// are either streamed to `onResult` as they finish (through the thread-safe progress queue)
+// or collected and resolved as one array
+class UndistortManyWorker : public Napi::AsyncProgressQueueWorker<BatchResult>
+{
+public:
+    UndistortManyWorker(Napi::Env env, Napi::Array jsImagesArray, cv::Matx33d k, cv::Vec4d d, float scale, EncodeOptions options, int concurrency)
+        : Napi::AsyncProgressQueueWorker<BatchResult>(env), deferred(Napi::Promise::Deferred::New(env)),
+          k(k), d(d), scale(scale), options(options), concurrency(concurrency)
+    {
+        for (uint32_t i = 0; i < jsImagesArray.Length(); i++)
+        {
+            Napi::Buffer<uchar> img = jsImagesArray.Get(i).As<Napi::Buffer<uchar>>();
+            buffers.push_back(std::make_pair(img.Data(), img.Length()));
+            bufferRefs.push_back(Napi::Persistent(img));
+        }
+        results.resize(buffers.size());
+    }
+
+    void Stream(Napi::Function onResult)
+    {
+        this->onResult = Napi::Persistent(onResult);
+        streaming = true;
+    }
+
+    Napi::Promise Promise() { return deferred.Promise(); }
+
+    void Execute(const ExecutionProgress &progress) override
+    {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        int count = std::max(1, std::min(concurrency, int(buffers.size())));
+        for (int t = 0; t < count; t++)
+        {
+            threads.emplace_back([&] {
+                for (size_t i = next++; i < buffers.size(); i = next++)
+                {
+                    BatchResult result = process(uint32_t(i));
+                    if (streaming)
+                    {
+                        progress.Send(&result, 1);
+                    }
+                    else
+                    {
+                        results[i] = result;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) thread.join();
+
+        if (!streaming)
+        {
+            for (auto const &result : results)
+            {
+                if (!result.error.empty())
+                {
+                    SetError(cv::format("Image %u: %s", result.index, result.error.c_str()));
+                    return;
+                }
+            }
+        }
+    }
+
+    void OnProgress(const BatchResult *data, size_t count) override
+    {
+        Napi::Env env = Env();
+        Napi::HandleScope scope(env);
+        for (size_t i = 0; i < count; i++)
+        {
+            Napi::Value error = env.Null();
+            Napi::Value buffer = env.Null();
+            if (data[i].error.empty())
+            {
+                buffer = toBuffer(env, std::move(*data[i].encoded));
+            }
+            else
+            {
+                error = Napi::Error::New(env, data[i].error).Value();
+            }
+            onResult.Call({error, buffer, Napi::Number::New(env, data[i].index)});
+        }
+    }
+
+    void OnOK() override
+    {
+        Napi::Env env = Env();
+        if (streaming)
+        {
+            deferred.Resolve(Napi::Number::New(env, double(buffers.size())));
+            return;
+        }
+
+        Napi::Array ret = Napi::Array::New(env, results.size());
+        for (uint32_t i = 0; i < results.size(); i++)
+        {
+            ret.Set(i, toBuffer(env, std::move(*results[i].encoded)));
+        }
+        deferred.Resolve(ret);
+    }
+
+    void OnError(const Napi::Error &e) override
+    {
+        deferred.Reject(e.Value());
+    }
+
+private:
+    BatchResult process(uint32_t index)
+    {
+        BatchResult result { index, std::make_shared<std::vector<uchar>>(), std::string() };
+        try
+        {
+            cv::Mat distorted = decodeImage(buffers[index].first, buffers[index].second);
+            if (distorted.empty())
+            {
+                result.error = "Could not decode image";
+                return result;
+            }
+            *result.encoded = encodeImage(remapMat(distorted, *getMaps(distorted.size())), options);
+        }
+        catch (const cv::Exception &e)
+        {
+            result.error = e.what();
+        }
+        return result;
+    }
+
+    // Tables are built by the first thread that sees a size, the others wait for them
+    std::shared_ptr<const UndistortMaps> getMaps(cv::Size size)
+    {
+        std::lock_guard<std::mutex> lock(mapsMutex);
+        std::shared_ptr<const UndistortMaps> &maps = mapsBySize[std::make_pair(size.width, size.height)];
+        if (!maps) maps = createUndistortMaps(k, d, size, scale);
+        return maps;
+    }
+
+    Napi::Promise::Deferred deferred;
+    Napi::FunctionReference onResult;
+    bool streaming = false;
+    std::vector<Napi::Reference<Napi::Buffer<uchar>>> bufferRefs;
+    std::vector<std::pair<const uchar*, size_t>> buffers;
+    std::vector<BatchResult> results;
+    cv::Matx33d k;
+    cv::Vec4d d;
+    float scale;
+    EncodeOptions options;
+    int concurrency;
+    std::mutex mapsMutex;
+    std::map<std::pair<int, int>, std::shared_ptr<const UndistortMaps>> mapsBySize;
+};
+
+// undistortMany(buffers, K, D, { concurrency, onResult, scale, extname, quantity })
+Napi::Value UndistortMany(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Array jsImagesArray = info[0].As<Napi::Array>();
+    Napi::Object jsExtra = getExtra(info, 3);
+
+    int concurrency = int(std::thread::hardware_concurrency());
+    if (jsExtra.Has("concurrency"))
+    {
+        concurrency = jsExtra.Get("concurrency").As<Napi::Number>().Int32Value();
+    }
+
+    UndistortManyWorker *worker = new UndistortManyWorker(env, jsImagesArray, getK(info[1].As<Napi::Array>()), getD(info[2].As<Napi::Array>()),
+                                                          getScale(jsExtra), getEncodeOptions(jsExtra), std::max(1, concurrency));
+    if (jsExtra.Has("onResult") && jsExtra.Get("onResult").IsFunction())
+    {
+        worker->Stream(jsExtra.Get("onResult").As<Napi::Function>());
+    }
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// --- Undistorter: one calibration, remap tables computed once ---
+
+class Undistorter : public Napi::ObjectWrap<Undistorter>
+{
+public:
+    static Napi::Function Define(Napi::Env env)
+    {
+        return DefineClass(env, "Undistorter", {
+            InstanceMethod("undistort", &Undistorter::Undistort),
+            InstanceMethod("undistortAsync", &Undistorter::UndistortAsync),
+            InstanceMethod("undistortRaw", &Undistorter::UndistortRaw),
+        });
+    }
+
+    // new Undistorter(K, D, [width, height], { scale, extname, quantity })
+    Undistorter(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Undistorter>(info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 3 || !info[0].IsArray() || !info[1].IsArray() || !info[2].IsArray())
+        {
+            Napi::TypeError::New(env, "Expected (K, D, [width, height], options?)").ThrowAsJavaScriptException();
+            return;
+        }
+
+        Napi::Array jsSize = info[2].As<Napi::Array>();
+        cv::Size size(jsSize.Get(uint32_t(0)).As<Napi::Number>().Int32Value(), jsSize.Get(uint32_t(1)).As<Napi::Number>().Int32Value());
+        if (size.width <= 0 || size.height <= 0)
+        {
+            Napi::RangeError::New(env, "Image size must be positive").ThrowAsJavaScriptException();
+            return;
+        }
+
+        Napi::Object jsExtra = getExtra(info, 3);
+        maps = createUndistortMaps(getK(info[0].As<Napi::Array>()), getD(info[1].As<Napi::Array>()), size, getScale(jsExtra));
+        options = getEncodeOptions(jsExtra);
+    }
+
+private:
+    // Per-call options override single encoder settings of the constructor defaults
+    EncodeOptions encodeOptions(const Napi::CallbackInfo &info)
+    {
+        return info.Length() > 1 && info[1].IsObject() ? getEncodeOptions(info[1].As<Napi::Object>(), options) : options;
+    }
+
+    Napi::Value Undistort(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        cv::Mat distorted = toImageMat(info[0].As<Napi::Buffer<uchar>>());
+        if (distorted.size() != maps->inputSize)
+        {
+            Napi::Error::New(env, sizeMismatch(distorted.size(), maps->inputSize)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return toBuffer(env, encodeImage(remapMat(distorted, *maps), encodeOptions(info)));
+    }
+
+    Napi::Value UndistortAsync(const Napi::CallbackInfo &info)
+    {
+        // Workers hold their own reference to the tables, so they stay valid even if
+        // this object is collected before the work finishes
+        UndistortWorker *worker = new UndistortWorker(info.Env(), info[0].As<Napi::Buffer<uchar>>(), maps, encodeOptions(info));
+        Napi::Promise promise = worker->Promise();
+        worker->Queue();
+        return promise;
+    }
+
+    Napi::Value UndistortRaw(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        cv::Mat distorted;
+        if (!toRawMat(env, info[0].As<Napi::Buffer<uchar>>(), info[1].As<Napi::Object>(), distorted)) return env.Null();
+        if (distorted.size() != maps->inputSize)
+        {
+            Napi::Error::New(env, sizeMismatch(distorted.size(), maps->inputSize)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return remapRaw(env, distorted, *maps, getExtra(info, 2));
+    }
+
+    std::shared_ptr<const UndistortMaps> maps;
+    EncodeOptions options;
+};
+
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
     exports.Set("undistort", Napi::Function::New(env, Undistort));
     exports.Set("calibrate", Napi::Function::New(env, Calibrate));
+    exports.Set("undistortAsync", Napi::Function::New(env, UndistortAsync));
+    exports.Set("undistortRaw", Napi::Function::New(env, UndistortRaw));
+    exports.Set("undistortMany", Napi::Function::New(env, UndistortMany));
+    exports.Set("calibrateAsync", Napi::Function::New(env, CalibrateAsync));
+    exports.Set("Undistorter", Undistorter::Define(env));
     return exports;
 }
 
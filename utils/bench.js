@@ -0,0 +1,106 @@
+"use strict";
+
+// Throughput of the N-API bindings on the synthetic boards written by
+// `./fisheye --bench <w>x<h> --bench-out <dir>`, printed as JSON in the same shape as the
+// C++ benchmark so the two can be compared.
+//
+// Usage: node utils/bench.js <samples_dir> [checkboard_width] [checkboard_height] [concurrency]
+
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const { Jimp } = require("jimp");
+const fisheye = require("..");
+
+function percentile(sorted, q) {
+  return sorted[Math.min(sorted.length - 1, Math.round(q * (sorted.length - 1)))];
+}
+
+function stage(ms, extra) {
+  if (ms.length === 0) return { images: 0 };
+  const sorted = ms.slice().sort((a, b) => a - b);
+  const total = ms.reduce((a, b) => a + b, 0);
+  return Object.assign({
+    images: ms.length,
+    imagesPerSec: ms.length * 1000 / total,
+    p50Ms: percentile(sorted, 0.5),
+    p90Ms: percentile(sorted, 0.9),
+    p99Ms: percentile(sorted, 0.99),
+    maxMs: percentile(sorted, 1),
+  }, extra);
+}
+
+function timeMs(fn) {
+  const start = process.hrtime.bigint();
+  fn();
+  return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+async function timeMsAsync(fn) {
+  const start = process.hrtime.bigint();
+  await fn();
+  return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+async function main() {
+  const [samplesDir, width = "9", height = "6", concurrency = String(os.cpus().length)] = process.argv.slice(2);
+  if (!samplesDir) {
+    console.log("Usage: node utils/bench.js <samples_dir> [checkboard_width] [checkboard_height] [concurrency]");
+    process.exit(1);
+  }
+
+  const files = fs.readdirSync(samplesDir)
+    .filter(f => f.match(/\.(jpg|jpeg|png)$/i))
+    .sort()
+    .map(f => path.join(samplesDir, f));
+  const images = files.map(f => fs.readFileSync(f));
+  if (images.length === 0) throw new Error(`No images found in ${samplesDir}`);
+
+  // Calibration includes decoding and corner detection of every board, matching the C++
+  // calibrateEndToEnd stage. The bindings do not expose the solve on its own
+  const calibrateMs = [];
+  let K, D;
+  for (let i = 0; i < 3; i++) {
+    calibrateMs.push(timeMs(() => ({ K, D } = fisheye.calibrate(images, parseInt(width), parseInt(height)))));
+  }
+  const calibrateAsyncMs = [await timeMsAsync(() => fisheye.calibrateAsync(images, parseInt(width), parseInt(height)))];
+
+  const opts = { extname: ".jpg" };
+  const undistortMs = images.map(img => timeMs(() => fisheye.undistort(img, K, D, opts)));
+
+  const decoded = await Jimp.read(images[0]);
+  const { width: w, height: h } = decoded.bitmap;
+  let undistorter;
+  const mapsMs = [timeMs(() => { undistorter = new fisheye.Undistorter(K, D, [w, h], opts); })];
+  const undistorterMs = images.map(img => timeMs(() => undistorter.undistort(img)));
+
+  // Raw RGBA frames, decoded up front so only the remap is measured. The C++ remap stage
+  // also runs on 4 channel frames
+  const frames = [];
+  for (const img of images) frames.push((await Jimp.read(img)).bitmap);
+  const output = Buffer.alloc(w * h * 4);
+  const rawMs = frames.map(f => timeMs(() => undistorter.undistortRaw(f.data, { width: f.width, height: f.height, channels: 4 }, { output })));
+
+  const batchMs = await timeMsAsync(() => fisheye.undistortMany(images, K, D, Object.assign({ concurrency: parseInt(concurrency) }, opts)));
+
+  const result = {
+    binding: "napi",
+    resolution: [w, h],
+    board: [parseInt(width), parseInt(height)],
+    threads: parseInt(concurrency),
+    calibrateEndToEnd: stage(calibrateMs, { views: images.length }),
+    calibrateEndToEndAsync: stage(calibrateAsyncMs),
+    undistortMaps: stage(mapsMs),
+    remap: stage(rawMs),
+    undistort: stage(undistorterMs),
+    undistortUncached: stage(undistortMs),
+    undistortBatch: { images: images.length, imagesPerSec: images.length * 1000 / batchMs },
+    peakRssKb: process.resourceUsage().maxRSS,
+  };
+  console.log(JSON.stringify(result, null, 2));
+}
+
+main().catch(err => {
+  console.error("Error:", err.message);
+  process.exit(1);
+});